@@ -0,0 +1,496 @@
+#include "headers/accelerometer.h"
+
+#include "headers/activity.h"
+#include "headers/interrupts.h"
+
+/*
+  BMA421 accelerometer driver (the Bosch BMA423 API works for it, see BMA423_CHIP_ID in bma423.h)
+  Rather than waking the CPU for every sample, the accelerometer buffers samples in its FIFO and only raises BMA421_INT
+  when ACCEL_WATERMARK_FRAMES are waiting, so at 100Hz the CPU wakes twice a second instead of 100 times
+  On the interrupt a coroutine reads the FIFO length and then the whole FIFO through the I2C scheduler (in chunks of whole
+  frames, as EasyDMA can only do 255 bytes and a partly read frame is sent again), so nothing waits for the bus
+  The FIFO is in header mode with the sensor time enabled, so reading it empty adds a sensor time frame after the last
+  sample, which is used to timestamp every sample in the burst. The samples are put in a ring buffer, which any number
+  of readers can read from with their own read index (see readAccelSamples())
+  The single and double tap features share the pin with the watermark (the P8 only wires up INT1), so the interrupt
+  coroutine reads the interrupt status first to find out which it was. A double tap wakes the watch without the touch
+  controller, which stays in deep sleep until a single tap or the button shows the user is actually using the watch
+  Wrist raise uses the any-motion interrupt on the same pin. Whilst asleep, motion is followed by a check that the watch
+  has ended up face up after being some other way up (see checkRaise()), so the CPU only runs when the sensor has seen
+  movement rather than polling the orientation
+  Setup uses the Bosch API with blocking bus functions for the few single registers, which is fine because it only runs
+  at boot, but the feature config upload is done by the init coroutine (see accelInitSequence())
+ */
+
+static uint8_t bmaAddress = ACCEL_ADDRESS;
+struct bma4_dev bmaDevice;
+bool accelReady = false;
+CoTask accelSequenceTask;  //Setup, then interrupt handling (which only starts once setup has finished)
+
+uint8_t intStatusBuf[2];
+uint32_t accelInterruptTick;  //RTC tick of the interrupt edge (the time of the tap or motion)
+volatile bool accelInterruptPending = false;  //An edge came in whilst the coroutine was running (a tap pulse may be over by the time the pin is checked)
+uint8_t accelDataBuf[BMA4_ACCEL_DATA_LENGTH];
+bool raiseWakeEnabled = ACCEL_RAISE_WAKE_DEFAULT;
+uint32_t raiseWakeTime;  //millis() of the last raise wake, to tell whether it has been held up for ACCEL_RAISE_CONFIRM_MS
+uint8_t fifoLengthBuf[2];
+uint8_t fifoBuffer[ACCEL_FIFO_READ_SIZE];
+uint16_t fifoReadLength;
+bool fifoReadTimed;           //The read reached the end of the FIFO, so it ends with the sensor time frame
+uint16_t untimedSamples = 0;  //Samples from earlier passes of the same drain, that get their time from the pass that reaches the end
+struct bma4_accel fifoFrames[ACCEL_MAX_FRAMES];
+
+AccelSample accelRing[ACCEL_RING_SIZE];
+uint32_t accelRingHead = 0;  //Total samples ever written (masked when indexing)
+uint32_t accelDrainCount = 0;
+uint32_t accelTapWakeCount = 0;
+uint32_t accelConfigUploadTicks = 0;
+
+/*
+  Reset and set up the accelerometer in the background, the returned coroutine is finished when it is running
+ */
+CoTask* initAccel() {
+  pinMode(BMA421_INT, INPUT);
+  startCoroutine(&accelSequenceTask, accelInitSequence);
+  return &accelSequenceTask;
+}
+
+/*
+  Set up the Bosch API, check the chip ID and get ready for the config upload (blocking, but only a few bytes)
+  Returns true if the accelerometer was found
+ */
+static bool beginAccelSetup() {
+  bmaDevice.intf = BMA4_I2C_INTF;
+  bmaDevice.bus_read = accelI2CRead;
+  bmaDevice.bus_write = accelI2CWrite;
+  bmaDevice.variant = BMA42X_VARIANT;
+  bmaDevice.intf_ptr = &bmaAddress;
+  bmaDevice.delay_us = accelDelay;
+  bmaDevice.read_write_len = I2C_MAX_WRITE_LENGTH;  //Feature config chunk length, so every write can be copied by the I2C scheduler
+
+  uint8_t initCtrl = 0;  //Config loading disabled whilst uploading
+  int8_t result = bma423_init(&bmaDevice);
+  if (result == BMA4_OK)
+    result = bma4_set_advance_power_save(BMA4_DISABLE, &bmaDevice);  //Burst writes aren't allowed in power save
+  if (result == BMA4_OK)
+    result = bma4_write_regs(BMA4_INIT_CTRL_ADDR, &initCtrl, 1, &bmaDevice);
+  return result == BMA4_OK;
+}
+
+/*
+  Configure the sensor and start the FIFO once the config has been loaded (blocking)
+  Returns true if everything was written
+ */
+static bool finishAccelSetup() {
+  struct bma4_accel_config accelConfig;
+  accelConfig.odr = BMA4_OUTPUT_DATA_RATE_100HZ;
+  accelConfig.range = BMA4_ACCEL_RANGE_2G;
+  accelConfig.bandwidth = BMA4_ACCEL_NORMAL_AVG4;
+  accelConfig.perf_mode = BMA4_CIC_AVG_MODE;  //Duty cycled averaging, rather than running continuously
+
+  struct bma4_int_pin_config pinConfig;
+  pinConfig.edge_ctrl = BMA4_LEVEL_TRIGGER;  //High for as long as the FIFO is above the watermark (taps are a short pulse)
+  pinConfig.lvl = BMA4_ACTIVE_HIGH;
+  pinConfig.od = BMA4_PUSH_PULL;
+  pinConfig.output_en = BMA4_OUTPUT_ENABLE;
+  pinConfig.input_en = BMA4_INPUT_DISABLE;
+
+  struct bma423_any_no_mot_config anyMotion;
+  anyMotion.threshold = ACCEL_RAISE_MOTION_THRESHOLD;
+  anyMotion.duration = ACCEL_RAISE_MOTION_DURATION;
+  anyMotion.axes_en = BMA423_EN_ALL_AXIS;
+
+  uint16_t intMap = BMA4_FIFO_WM_INT | ACCEL_TAP_INTS;
+  if (raiseWakeEnabled)
+    intMap |= BMA423_ANY_MOT_INT;
+
+  //The features are in the feature config, which is written before power save is back on (it doesn't allow burst writes)
+  int8_t result = bma423_feature_enable(BMA423_SINGLE_TAP | BMA423_DOUBLE_TAP, BMA4_ENABLE, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma423_set_any_mot_config(&anyMotion, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma423_single_tap_set_sensitivity(ACCEL_SINGLE_TAP_SENSITIVITY, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma423_double_tap_set_sensitivity(ACCEL_DOUBLE_TAP_SENSITIVITY, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma4_set_advance_power_save(BMA4_ENABLE, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma4_set_accel_config(&accelConfig, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma4_set_accel_enable(BMA4_ENABLE, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma4_set_fifo_config(BMA4_FIFO_ACCEL | BMA4_FIFO_HEADER | BMA4_FIFO_TIME, BMA4_ENABLE, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma4_set_fifo_wm(ACCEL_WATERMARK_FRAMES * ACCEL_FRAME_LENGTH, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma4_set_int_pin_config(&pinConfig, BMA4_INTR1_MAP, &bmaDevice);
+  if (result == BMA4_OK)
+    result = bma423_map_interrupt(BMA4_INTR1_MAP, intMap, BMA4_ENABLE, &bmaDevice);
+  return result == BMA4_OK;
+}
+
+/*
+  Length of the config upload chunk that starts at offset
+ */
+static uint8_t configChunkLength(uint16_t offset) {
+  uint16_t remaining = bmaDevice.config_size - offset;
+  return remaining < ACCEL_CONFIG_CHUNK_LENGTH ? remaining : ACCEL_CONFIG_CHUNK_LENGTH;
+}
+
+/*
+  Copy the next chunk of the config (which is in flash, where EasyDMA can't read from) into RAM after the register address
+  The FIFO buffer is used, as nothing is read from the FIFO until setup has finished
+ */
+static void loadConfigChunk(uint16_t offset) {
+  fifoBuffer[0] = BMA4_FEATURE_CONFIG_ADDR;
+  memcpy(fifoBuffer + 1, bmaDevice.config_file_ptr + offset, configChunkLength(offset));
+}
+
+/*
+  Coroutine that soft resets the accelerometer (it keeps its config through a reset of the nRF) and sets it up
+  The 6KB feature config is the slow part. Bosch's bma423_write_config_file() writes it in read_write_len chunks, each
+  needing a transaction to set the config address and one for the data, and then blocks for 150ms whilst the sensor
+  loads it. Instead it is written here in chunks as long as an EasyDMA transfer allows, through the I2C scheduler
+  (so touch reads still go first), and the load is waited for without blocking, so the rest of boot carries on
+  The time the upload took is kept (see getAccelConfigUploadUS())
+  If the accelerometer isn't found, the sensors watchdog channel stays parked and nothing else uses it
+ */
+uint8_t accelInitSequence(CoTask* co) {
+  static const uint8_t softReset = BMA4_SOFT_RESET;
+  static const uint8_t configLoad = 1;
+  static uint16_t offset;
+  static uint32_t uploadStartTick;
+  static uint8_t configAddress[2];
+  static uint8_t internalStatus;
+  CO_BEGIN(co);
+  CO_AWAIT_I2C_WRITE(co, ACCEL_ADDRESS, BMA4_CMD_ADDR, &softReset, 1);
+  CO_DELAY_MS(co, 5);
+  accelReady = beginAccelSetup();
+  if (accelReady) {
+    CO_DELAY_MS(co, 1);  //Power save takes 450us to turn off
+    uploadStartTick = RTC_TICKS();
+    for (offset = 0; offset < bmaDevice.config_size; offset += ACCEL_CONFIG_CHUNK_LENGTH) {
+      configAddress[0] = (offset / 2) & 0x0F;  //The config address is in 16 bit words, split over two registers
+      configAddress[1] = (offset / 2) >> 4;
+      CO_AWAIT_I2C_WRITE(co, ACCEL_ADDRESS, BMA4_RESERVED_REG_5B_ADDR, configAddress, 2);
+      loadConfigChunk(offset);
+      CO_AWAIT_I2C_TRANSFER(co, ACCEL_ADDRESS, fifoBuffer, configChunkLength(offset) + 1, NULL, 0);
+      if (!co->i2cSuccess)
+        break;
+    }
+    accelConfigUploadTicks = RTC_TICK_DIFF(RTC_TICKS(), uploadStartTick);
+    accelReady = offset >= bmaDevice.config_size;
+  }
+  if (accelReady) {
+    CO_AWAIT_I2C_WRITE(co, ACCEL_ADDRESS, BMA4_INIT_CTRL_ADDR, &configLoad, 1);
+    CO_DELAY_MS(co, ACCEL_CONFIG_LOAD_MS);
+    CO_AWAIT_I2C_READ(co, ACCEL_ADDRESS, BMA4_INTERNAL_STAT, &internalStatus, 1);
+    accelReady = co->i2cSuccess && (internalStatus & BMA4_CONFIG_STREAM_MESSAGE_MSK) == BMA4_ASIC_INITIALIZED;
+  }
+  if (accelReady) {
+    //The feature config start address, which the Bosch API needs to change feature settings
+    CO_AWAIT_I2C_READ(co, ACCEL_ADDRESS, BMA4_RESERVED_REG_5B_ADDR, configAddress, 2);
+    bmaDevice.asic_data.asic_lsb = configAddress[0] & 0x0F;
+    bmaDevice.asic_data.asic_msb = configAddress[1];
+    accelReady = co->i2cSuccess && finishAccelSetup();
+  }
+  if (accelReady) {
+    addGPIOEventSource(BMA421_INT, EVENT_SOURCE_ACCEL, EDGE_MASK_RISING);
+    parkWatchdogChannel(WATCHDOG_CHANNEL_SENSORS, false);  //The watermark interrupt checks in twice a second
+  }
+  CO_END(co);
+}
+
+/*
+  Get how long the feature config upload took in microseconds (0 if it hasn't happened)
+ */
+uint32_t getAccelConfigUploadUS() {
+  return RTC_TICKS_TO_US(accelConfigUploadTicks);
+}
+
+/*
+  Check whether the accelerometer was found and set up
+ */
+bool isAccelReady() {
+  return accelReady;
+}
+
+/*
+  Turn wrist raise wake on or off (blocking, so only call from the UI)
+  With it off the any-motion interrupt isn't mapped, so it costs nothing (to compare against button only waking)
+ */
+void setRaiseWake(bool enable) {
+  raiseWakeEnabled = enable;
+  if (accelReady)
+    bma423_map_interrupt(BMA4_INTR1_MAP, BMA423_ANY_MOT_INT, enable ? BMA4_ENABLE : BMA4_DISABLE, &bmaDevice);
+}
+
+/*
+  Check whether wrist raise wake is on
+ */
+bool getRaiseWake() {
+  return raiseWakeEnabled;
+}
+
+/*
+  Called by handleInterrupts() on the rising edge of the accelerometer interrupt (a tap, motion, or the FIFO reaching
+  the watermark), edgeTick is the RTC tick of the edge
+  If the coroutine is already running it is told to check the status again
+ */
+void accelInterrupt(uint32_t edgeTick) {
+  if (isCoroutineRunning(&accelSequenceTask)) {
+    accelInterruptPending = true;
+    return;
+  }
+  accelInterruptTick = edgeTick;
+  startCoroutine(&accelSequenceTask, accelInterruptSequence);
+}
+
+/*
+  Parse the FIFO data that was read and add the samples to the ring buffer
+  The sensor time frame is the time of the last sample, and the samples before it are one ODR period apart. A pass that
+  didn't reach the end of the FIFO has no sensor time frame, so its samples are given a time carrying on from the sample
+  before them, until the pass that does reach the end times them properly
+ */
+static void storeFIFOData() {
+  struct bma4_fifo_frame fifo;
+  memset(&fifo, 0, sizeof(fifo));
+  fifo.data = fifoBuffer;
+  fifo.length = fifoReadLength;
+  fifo.fifo_header_enable = BMA4_FIFO_HEADER;  //What bma4_read_fifo_data() would read back from the FIFO config
+  fifo.fifo_data_enable = BMA4_FIFO_A_ENABLE;
+  uint16_t numFrames = ACCEL_MAX_FRAMES;
+  if (bma4_extract_accel(fifoFrames, &numFrames, &fifo, &bmaDevice) != BMA4_OK)
+    return;
+
+  for (uint16_t i = 0; i < numFrames; i++) {
+    AccelSample* sample = &accelRing[accelRingHead & (ACCEL_RING_SIZE - 1)];
+    sample->x = fifoFrames[i].x;
+    sample->y = fifoFrames[i].y;
+    sample->z = fifoFrames[i].z;
+    if (accelRingHead != 0)
+      sample->sensorTime = (accelRing[(accelRingHead - 1) & (ACCEL_RING_SIZE - 1)].sensorTime + ACCEL_SENSORTIME_PER_SAMPLE) & ACCEL_SENSORTIME_MASK;
+    accelRingHead++;
+  }
+  if (!fifoReadTimed) {
+    untimedSamples += numFrames;
+    return;
+  }
+
+  uint32_t timed = numFrames + untimedSamples;
+  if (timed > ACCEL_RING_SIZE)
+    timed = ACCEL_RING_SIZE;
+  if (timed > accelRingHead)
+    timed = accelRingHead;
+  for (uint32_t i = 0; i < timed; i++)
+    accelRing[(accelRingHead - 1 - i) & (ACCEL_RING_SIZE - 1)].sensorTime = (fifo.sensor_time - i * ACCEL_SENSORTIME_PER_SAMPLE) & ACCEL_SENSORTIME_MASK;
+  untimedSamples = 0;
+}
+
+/*
+  Check whether a reading is face up (see the ACCEL_RAISE definitions)
+ */
+static bool isFaceUp(int16_t x, int16_t y, int16_t z) {
+  int16_t faceZ = z * ACCEL_RAISE_Z_SIGN;
+  return faceZ > ACCEL_RAISE_MIN_FACE_UP && x < ACCEL_RAISE_MAX_TILT && x > -ACCEL_RAISE_MAX_TILT && y < ACCEL_RAISE_MAX_TILT && y > -ACCEL_RAISE_MAX_TILT;
+}
+
+/*
+  Check whether the newest sample in the ring buffer (from before the motion, as the FIFO is at most a watermark behind)
+  was face up. If nothing has been sampled yet it counts as face up, so there is no raise
+ */
+static bool wasFaceUp() {
+  if (accelRingHead == 0)
+    return true;
+  AccelSample* sample = &accelRing[(accelRingHead - 1) & (ACCEL_RING_SIZE - 1)];
+  return isFaceUp(sample->x, sample->y, sample->z);
+}
+
+/*
+  Check whether the accelerometer data registers that were read are face up (12 bit, left aligned, little endian)
+ */
+static bool readingFaceUp() {
+  int16_t x = (int16_t)(accelDataBuf[0] | (accelDataBuf[1] << 8)) >> 4;
+  int16_t y = (int16_t)(accelDataBuf[2] | (accelDataBuf[3] << 8)) >> 4;
+  int16_t z = (int16_t)(accelDataBuf[4] | (accelDataBuf[5] << 8)) >> 4;
+  return isFaceUp(x, y, z);
+}
+
+/*
+  Called after each FIFO drain whilst a raise wake hasn't been confirmed or turned out false yet (see raiseWake())
+  Lowering the watch (the newest sample isn't face up) within ACCEL_RAISE_CONFIRM_MS makes it a false wake, still
+  being face up after that confirms it
+ */
+static void checkRaiseWake() {
+  if (!isRaiseWakeUnconfirmed())
+    return;
+  if (!wasFaceUp())
+    endRaiseWakeCheck(true);
+  else if (millis() - raiseWakeTime >= ACCEL_RAISE_CONFIRM_MS)
+    endRaiseWakeCheck(false);
+}
+
+/*
+  Length of the FIFO read chunk that starts at offset
+ */
+static uint8_t fifoChunkLength(uint16_t offset) {
+  uint16_t remaining = fifoReadLength - offset;
+  return remaining < ACCEL_FIFO_CHUNK_LENGTH ? remaining : ACCEL_FIFO_CHUNK_LENGTH;
+}
+
+/*
+  Coroutine that reads the interrupt status (which clears it), handles a tap or a possible wrist raise, and then reads
+  everything in the FIFO in one burst (split into chunks of whole frames) if it was the watermark
+  Motion whilst asleep is a raise if the watch was not face up before it and is face up once it has settled for
+  ACCEL_RAISE_SETTLE_MS, the settle wait is what stops an arm swing that passes through face up from waking the watch
+  A FIFO holding more than ACCEL_FIFO_MAX_READ (eg after the raise settle wait) is read in several passes, each of
+  whole frames. If the interrupt pin is still high afterwards (more samples arrived, or a read failed), another edge
+  came in whilst running, or the FIFO wasn't read to the end, it goes round again, since the level triggered interrupt
+  won't give another rising edge. If the accelerometer stops answering altogether, the sensors watchdog channel stops
+  being checked in
+ */
+uint8_t accelInterruptSequence(CoTask* co) {
+  static uint16_t offset;
+  static uint16_t intStatus;
+  static uint32_t eventTick;
+  static bool raiseFromFaceUp;
+  static bool fifoDrainPending;  //The last pass didn't reach the end of the FIFO
+  CO_BEGIN(co);
+  fifoDrainPending = false;  //A drain cut short by a restart can't be timed by this one
+  untimedSamples = 0;
+  do {
+    accelInterruptPending = false;
+    CO_AWAIT_I2C_READ(co, ACCEL_ADDRESS, BMA4_INT_STAT_0_ADDR, intStatusBuf, 2);
+    if (!co->i2cSuccess)
+      continue;
+    intStatus = intStatusBuf[0] | (intStatusBuf[1] << 8);
+    eventTick = accelInterruptTick;
+    accelInterruptTick = RTC_TICKS();  //A tap seen on a later pass happened after this read
+    if (intStatus & ACCEL_TAP_INTS) {
+      if (handleAccelTap(intStatus & BMA423_DOUBLE_TAP_INT, eventTick))
+        accelTapWakeCount++;
+    }
+    if ((intStatus & BMA423_ANY_MOT_INT) && raiseWakeEnabled && getPowerMode() == POWER_OFF) {
+      raiseFromFaceUp = wasFaceUp();
+      CO_DELAY_MS(co, ACCEL_RAISE_SETTLE_MS);
+      CO_AWAIT_I2C_READ(co, ACCEL_ADDRESS, BMA4_DATA_8_ADDR, accelDataBuf, BMA4_ACCEL_DATA_LENGTH);
+      if (co->i2cSuccess && !raiseFromFaceUp && readingFaceUp() && getPowerMode() == POWER_OFF) {
+        raiseWakeTime = millis();
+        raiseWake(eventTick);
+      }
+    }
+    if (!(intStatus & (BMA4_FIFO_WM_INT | BMA4_FIFO_FULL_INT)) && !fifoDrainPending)
+      continue;  //Just a tap or motion
+    CO_AWAIT_I2C_READ(co, ACCEL_ADDRESS, BMA4_FIFO_LENGTH_0_ADDR, fifoLengthBuf, 2);
+    fifoDrainPending = false;
+    if (!co->i2cSuccess)
+      continue;  //Try again (if the pin is still high)
+    fifoReadLength = (((fifoLengthBuf[1] & BMA4_FIFO_BYTE_COUNTER_MSB_MSK) << 8) | fifoLengthBuf[0]) + ACCEL_SENSORTIME_FRAME_LENGTH;
+    fifoReadTimed = fifoReadLength <= ACCEL_FIFO_MAX_READ;
+    if (!fifoReadTimed)
+      fifoReadLength = ACCEL_FIFO_MAX_READ;
+    for (offset = 0; offset < fifoReadLength; offset += ACCEL_FIFO_CHUNK_LENGTH) {
+      CO_AWAIT_I2C_READ(co, ACCEL_ADDRESS, BMA4_FIFO_DATA_ADDR, fifoBuffer + offset, fifoChunkLength(offset));
+      if (!co->i2cSuccess)
+        break;
+    }
+    if (offset < fifoReadLength)
+      continue;
+    fifoDrainPending = !fifoReadTimed;
+    storeFIFOData();
+    updateActivity();
+    checkRaiseWake();
+    accelDrainCount++;
+    watchdogCheckIn(WATCHDOG_CHANNEL_SENSORS);
+  } while (digitalRead(BMA421_INT) == HIGH || accelInterruptPending || fifoDrainPending);
+  CO_END(co);
+}
+
+/*
+  Copy the samples after *readIndex into samples (up to maxSamples), and move *readIndex on
+  Each reader keeps its own index (start it at getAccelSampleCount() to only get new samples)
+  If a reader has fallen more than ACCEL_RING_SIZE behind, the samples it missed are skipped
+  Returns the number of samples copied
+ */
+uint16_t readAccelSamples(uint32_t* readIndex, AccelSample* samples, uint16_t maxSamples) {
+  if (accelRingHead - *readIndex > ACCEL_RING_SIZE)
+    *readIndex = accelRingHead - ACCEL_RING_SIZE;
+  uint16_t count = 0;
+  while (*readIndex != accelRingHead && count < maxSamples) {
+    samples[count++] = accelRing[*readIndex & (ACCEL_RING_SIZE - 1)];
+    (*readIndex)++;
+  }
+  return count;
+}
+
+/*
+  Get the total number of samples received
+ */
+uint32_t getAccelSampleCount() {
+  return accelRingHead;
+}
+
+/*
+  Get the number of times the FIFO has been drained (ie the number of CPU wakes for the accelerometer)
+ */
+uint32_t getAccelDrainCount() {
+  return accelDrainCount;
+}
+
+/*
+  Get the number of times a double tap has woken the watch
+ */
+uint32_t getAccelTapWakeCount() {
+  return accelTapWakeCount;
+}
+
+/*
+  Stop sampling (before System OFF, where nothing would read the FIFO) (blocking)
+  The accelerometer is set up again by the next boot
+ */
+void sleepAccel() {
+  if (!accelReady)
+    return;
+  cancelCoroutine(&accelSequenceTask);
+  bma4_set_accel_enable(BMA4_DISABLE, &bmaDevice);
+}
+
+/*
+  The Bosch API requires pointers to functions that read and write to the i2c bus, these go through the I2C scheduler
+  EasyDMA transfers are at most 255 bytes, so longer reads are split up. Reads of the FIFO data register stay on that
+  register, anything else carries on from the next register
+ */
+int8_t accelI2CRead(uint8_t registerAddress, uint8_t* readBuf, uint32_t readBufLength, void* intf_ptr) {
+  uint32_t offset = 0;
+  while (offset < readBufLength) {
+    uint32_t remaining = readBufLength - offset;
+    uint8_t length = remaining < ACCEL_FIFO_CHUNK_LENGTH ? remaining : ACCEL_FIFO_CHUNK_LENGTH;
+    uint8_t reg = registerAddress == BMA4_FIFO_DATA_ADDR ? registerAddress : registerAddress + offset;
+    if (!i2cReadRegistersBlocking(*(uint8_t*)intf_ptr, reg, readBuf + offset, length))
+      return BMA4_E_COM_FAIL;
+    offset += length;
+  }
+  return BMA4_INTF_RET_SUCCESS;
+}
+
+/*
+  Write function for the Bosch API (split into writes that the I2C scheduler can copy)
+ */
+int8_t accelI2CWrite(uint8_t registerAddress, const uint8_t* writeBuf, uint32_t writeBufLength, void* intf_ptr) {
+  uint32_t offset = 0;
+  while (offset < writeBufLength) {
+    uint32_t remaining = writeBufLength - offset;
+    uint8_t length = remaining < I2C_MAX_WRITE_LENGTH ? remaining : I2C_MAX_WRITE_LENGTH;
+    if (!i2cWriteRegistersBlocking(*(uint8_t*)intf_ptr, registerAddress + offset, writeBuf + offset, length))
+      return BMA4_E_COM_FAIL;
+    offset += length;
+  }
+  return BMA4_INTF_RET_SUCCESS;
+}
+
+/*
+  Delay in micro seconds for the Bosch API
+*/
+void accelDelay(uint32_t period_us, void* intf_ptr) {
+  delayMicroseconds(period_us);
+}
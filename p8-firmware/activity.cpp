@@ -0,0 +1,201 @@
+#include "headers/activity.h"
+
+/*
+  Activity classifier, run on the newest ACTIVITY_WINDOW_SAMPLES accelerometer samples every time the FIFO is drained
+  The Bosch activity output only knows still/walking/running, so instead the features are worked out here from the
+  magnitude of the acceleration (which doesn't depend on how the wrist is turned):
+    - the mean magnitude and the energy of the deviation from it
+    - the number of zero crossings of the deviation
+    - the energy in a few low frequency bins (Goertzel, which is cheaper than an FFT for this few bins)
+  Everything is fixed point. The per sample work uses the M4's dual 16 bit instructions, so each SMLAD does two
+  samples: SMLAD with packed ones sums a pair, SMLAD of a pair with itself adds both squares, and QSUB16 takes the mean
+  off both samples (saturating). The Goertzel coefficients are Q14 with 64 bit products, as the filter state outgrows
+  16 bits. A window should be around 15k cycles (about 0.25ms at 64MHz), the real time is measured with the DWT cycle
+  counter (see getActivityClassifyUS())
+ */
+
+const int32_t goertzelCoeffs[ACTIVITY_NUM_BINS] = {32729, 32610, 32413, 32138, 31786};  //2cos(2 * pi * k / 128) in Q14, k = 1 - 5
+
+int16_t magnitudes[ACTIVITY_WINDOW_SAMPLES] __attribute__((aligned(4)));  //Read two at a time by the SIMD loops
+ActivityFeatures activityFeatures;
+uint8_t currentActivity = ACTIVITY_IDLE;
+uint8_t candidateActivity = ACTIVITY_IDLE;
+uint8_t candidateWindows = 0;
+uint32_t lastClassifyCycles = 0;
+uint32_t maxClassifyCycles = 0;
+
+const char* activityNames[NUM_ACTIVITIES] = {"idle   ", "walking", "running", "cycling"};  //Same length, so each overwrites the last
+
+/*
+  Read or write two packed int16_t values (index must be even, the memcpy compiles to a single load or store)
+ */
+static inline uint32_t readPair(const int16_t* values, uint16_t index) {
+  uint32_t pair;
+  memcpy(&pair, &values[index], sizeof(pair));
+  return pair;
+}
+
+static inline void writePair(int16_t* values, uint16_t index, uint32_t pair) {
+  memcpy(&values[index], &pair, sizeof(pair));
+}
+
+/*
+  Copy the newest window of samples out of the ring buffer as magnitudes
+  x and y go into one register, so SMLAD squares and adds them in one go
+  Returns false if there aren't enough samples yet
+ */
+static bool loadWindow() {
+  if (getAccelSampleCount() < ACTIVITY_WINDOW_SAMPLES)
+    return false;
+  uint32_t readIndex = getAccelSampleCount() - ACTIVITY_WINDOW_SAMPLES;
+  AccelSample batch[ACTIVITY_READ_BATCH];
+  uint16_t count = 0;
+  while (count < ACTIVITY_WINDOW_SAMPLES) {
+    uint16_t read = readAccelSamples(&readIndex, batch, ACTIVITY_READ_BATCH);
+    if (read == 0)
+      return false;
+    for (uint16_t i = 0; i < read && count < ACTIVITY_WINDOW_SAMPLES; i++) {
+      uint32_t xy = __PKHBT((uint16_t)batch[i].x, (uint32_t)batch[i].y, 16);
+      uint32_t squared = __SMLAD(xy, xy, (int32_t)batch[i].z * batch[i].z);
+      magnitudes[count++] = isqrt(squared);
+    }
+  }
+  return true;
+}
+
+/*
+  Energy of bin k (see goertzelCoeffs) of the deviations, scaled so it is the part of the window energy in that bin
+ */
+static uint32_t goertzelEnergy(const int16_t* deviations, int32_t coeff) {
+  int32_t s1 = 0, s2 = 0;
+  for (uint16_t i = 0; i < ACTIVITY_WINDOW_SAMPLES; i++) {
+    int32_t s0 = deviations[i] + (int32_t)(((int64_t)coeff * s1) >> ACTIVITY_COEFF_SHIFT) - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  int64_t power = (int64_t)s1 * s1 + (int64_t)s2 * s2 - ((((int64_t)coeff * s1) >> ACTIVITY_COEFF_SHIFT) * s2);
+  if (power < 0)  //Rounding
+    power = 0;
+  return (uint64_t)power * 2 / ACTIVITY_WINDOW_SAMPLES;  //Parseval, one side of the spectrum
+}
+
+/*
+  Work out the features of the window in magnitudes, leaving the deviations from the mean in place of the magnitudes
+ */
+static void extractFeatures(ActivityFeatures* features) {
+  int32_t sum = 0;
+  for (uint16_t i = 0; i < ACTIVITY_WINDOW_SAMPLES; i += 2)
+    sum = __SMLAD(readPair(magnitudes, i), 0x00010001, sum);
+  int16_t mean = sum / ACTIVITY_WINDOW_SAMPLES;
+  uint32_t meanPair = __PKHBT((uint16_t)mean, (uint32_t)mean, 16);
+
+  //Magnitudes are at most 3547 (2g on every axis), so the squared deviations of a window can't overflow 32 bits
+  int32_t energy = 0;
+  for (uint16_t i = 0; i < ACTIVITY_WINDOW_SAMPLES; i += 2) {
+    uint32_t deviationPair = __QSUB16(readPair(magnitudes, i), meanPair);
+    writePair(magnitudes, i, deviationPair);
+    energy = __SMLAD(deviationPair, deviationPair, energy);
+  }
+
+  uint16_t crossings = 0;
+  int8_t side = 0;  //Which side of the mean the last swing past the hysteresis was
+  for (uint16_t i = 0; i < ACTIVITY_WINDOW_SAMPLES; i++) {
+    int8_t newSide = magnitudes[i] > ACTIVITY_ZC_HYSTERESIS ? 1 : (magnitudes[i] < -ACTIVITY_ZC_HYSTERESIS ? -1 : 0);
+    if (newSide != 0 && newSide != side) {
+      if (side != 0)
+        crossings++;
+      side = newSide;
+    }
+  }
+
+  uint32_t binEnergy[ACTIVITY_NUM_BINS];
+  for (uint8_t k = 0; k < ACTIVITY_NUM_BINS; k++)
+    binEnergy[k] = goertzelEnergy(magnitudes, goertzelCoeffs[k]);
+
+  features->meanMagnitude = mean;
+  features->energy = energy;
+  features->zeroCrossings = crossings;
+  features->lowEnergy = binEnergy[0];
+  features->walkEnergy = binEnergy[1] + binEnergy[2];
+  features->runEnergy = binEnergy[3] + binEnergy[4];
+}
+
+/*
+  Pick the activity from the features of a window (see the ACTIVITY threshold definitions)
+  Walking and running have most of their energy at the step rate, running more of it higher up and harder. Cycling
+  moves the wrist without a step rhythm, so it is movement that isn't periodic but still crosses its mean often
+ */
+uint8_t classifyWindow(ActivityFeatures* features) {
+  if (features->energy < ACTIVITY_IDLE_ENERGY)
+    return ACTIVITY_IDLE;
+  uint32_t periodic = features->walkEnergy + features->runEnergy;
+  if ((uint64_t)periodic * 100 < (uint64_t)features->energy * ACTIVITY_MIN_PERIODIC_PERCENT)
+    return features->zeroCrossings >= ACTIVITY_CYCLING_MIN_CROSSINGS ? ACTIVITY_CYCLING : ACTIVITY_IDLE;
+  if (features->runEnergy > features->walkEnergy && features->energy >= ACTIVITY_RUN_ENERGY)
+    return ACTIVITY_RUN;
+  return ACTIVITY_WALK;
+}
+
+/*
+  Classify the newest window (called after every FIFO drain)
+  The activity only changes once ACTIVITY_CONFIRM_WINDOWS windows in a row agree, so one odd window is ignored
+ */
+void updateActivity() {
+  bool traceWasEnabled = CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk;
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;  //Only on whilst measuring, as the trace clock costs power
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  bool loaded = loadWindow();
+  if (loaded) {
+    extractFeatures(&activityFeatures);
+    uint8_t windowActivity = classifyWindow(&activityFeatures);
+    if (windowActivity == candidateActivity) {
+      if (candidateWindows < ACTIVITY_CONFIRM_WINDOWS)
+        candidateWindows++;
+    } else {
+      candidateActivity = windowActivity;
+      candidateWindows = 1;
+    }
+    if (candidateWindows >= ACTIVITY_CONFIRM_WINDOWS)
+      currentActivity = candidateActivity;
+  }
+
+  uint32_t cycles = DWT->CYCCNT;
+  if (!traceWasEnabled)
+    CoreDebug->DEMCR &= ~CoreDebug_DEMCR_TRCENA_Msk;
+  if (!loaded)
+    return;
+  lastClassifyCycles = cycles;
+  if (cycles > maxClassifyCycles)
+    maxClassifyCycles = cycles;
+}
+
+/*
+  Get the current activity (see ACTIVITY definitions)
+ */
+uint8_t getActivity() {
+  return currentActivity;
+}
+
+/*
+  Get the name of an activity (all padded to the same length)
+ */
+const char* getActivityName(uint8_t activity) {
+  return activity < NUM_ACTIVITIES ? activityNames[activity] : "";
+}
+
+/*
+  Get the features of the last window that was classified
+ */
+ActivityFeatures* getActivityFeatures() {
+  return &activityFeatures;
+}
+
+/*
+  Get the CPU time taken to load and classify a window in microseconds
+  (for the last window, or the worst seen if getMax is true)
+ */
+uint32_t getActivityClassifyUS(bool getMax) {
+  return (getMax ? maxClassifyCycles : lastClassifyCycles) / (SystemCoreClock / 1000000);
+}
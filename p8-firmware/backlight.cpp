@@ -0,0 +1,117 @@
+#include "headers/backlight.h"
+
+/*
+  Backlight driver on PWM0
+  The backlight has three active low enable pins with binary weighted currents, which used to be switched on and off as a
+  3 bit level. Now all three are driven by the same PWM channel value, so the brightness is the duty (0 - BACKLIGHT_PWM_TOP)
+  and the full current is 7 levels worth, just like before
+  A fade is a sequence of duty values that EasyDMA feeds to the PWM, each repeated for enough PWM periods to make up the fade
+  time, so once a fade starts it runs without the CPU and the PWM keeps outputting the last value when it ends
+  The values are spaced evenly in the square root of the duty (roughly how brightness is perceived), so fades look even
+  When the backlight fades to off the PWM is stopped and disabled (it runs from the 16MHz clock), which is the only time
+  the interrupt is used
+ */
+
+uint16_t fadeBuffers[2][BACKLIGHT_FADE_STEPS];  //A new fade is written to the buffer that isn't being played
+uint8_t nextFadeBuffer = 0;
+uint16_t fadeFromDuty = 0;
+uint16_t fadeToDuty = 0;
+uint32_t fadeStartTick = 0;
+uint32_t fadeTicks = 0;
+bool backlightPWMRunning = false;
+
+/* 
+  Set up PWM0 on the backlight pins (the pins must already be outputs and high, which is off)
+ */
+void initBacklight() {
+  NRF_PWM0->ENABLE = PWM_ENABLE_ENABLE_Disabled << PWM_ENABLE_ENABLE_Pos;
+  NRF_PWM0->PSEL.OUT[0] = LCD_BACKLIGHT_LOW;
+  NRF_PWM0->PSEL.OUT[1] = LCD_BACKLIGHT_MID;
+  NRF_PWM0->PSEL.OUT[2] = LCD_BACKLIGHT_HIGH;
+  NRF_PWM0->PSEL.OUT[3] = PWM_PSEL_OUT_CONNECT_Disconnected << PWM_PSEL_OUT_CONNECT_Pos;
+  NRF_PWM0->MODE = PWM_MODE_UPDOWN_Up << PWM_MODE_UPDOWN_Pos;
+  NRF_PWM0->PRESCALER = PWM_PRESCALER_PRESCALER_DIV_8 << PWM_PRESCALER_PRESCALER_Pos;  //2MHz
+  NRF_PWM0->COUNTERTOP = BACKLIGHT_PWM_TOP;
+  NRF_PWM0->LOOP = 0;
+  NRF_PWM0->DECODER = (PWM_DECODER_LOAD_Common << PWM_DECODER_LOAD_Pos) | (PWM_DECODER_MODE_RefreshCount << PWM_DECODER_MODE_Pos);
+  NRF_PWM0->SEQ[0].ENDDELAY = 0;
+  NRF_PWM0->INTENCLR = 0xFFFFFFFF;
+  NRF_PWM0->INTENSET = PWM_INTENSET_STOPPED_Msk;
+
+  NVIC_DisableIRQ(PWM0_IRQn);
+  NVIC_ClearPendingIRQ(PWM0_IRQn);
+  NVIC_SetPriority(PWM0_IRQn, BACKLIGHT_IRQ_PRIORITY);
+  NVIC_EnableIRQ(PWM0_IRQn);
+}
+
+/* 
+  Fade the backlight from its current duty to duty over fadeMS (0 = straight away)
+  A fade that is still running is replaced, starting from wherever it had got to
+ */
+void fadeBacklight(uint16_t duty, uint16_t fadeMS) {
+  if (duty > BACKLIGHT_PWM_TOP)
+    duty = BACKLIGHT_PWM_TOP;
+  uint16_t fromDuty = getBacklightDuty();
+  fadeFromDuty = fromDuty;
+  fadeToDuty = duty;
+  fadeStartTick = RTC_TICKS();
+  fadeTicks = MS_TO_RTC_TICKS(fadeMS);
+  setPowerState(POWER_CONSUMER_BACKLIGHT, (duty * BACKLIGHT_LEVELS + BACKLIGHT_PWM_TOP / 2) / BACKLIGHT_PWM_TOP);
+  if (duty == 0 && fromDuty == 0 && !backlightPWMRunning)  //Already off
+    return;
+
+  //Work out the number of values, each lasting a whole number of PWM periods
+  uint32_t fadePeriods = (uint32_t)fadeMS * 1000 / BACKLIGHT_PWM_PERIOD_US;
+  uint8_t steps = fadePeriods < BACKLIGHT_FADE_STEPS ? (fadePeriods > 0 ? fadePeriods : 1) : BACKLIGHT_FADE_STEPS;
+  uint32_t periodsPerStep = fadePeriods / steps;
+
+  uint16_t* values = fadeBuffers[nextFadeBuffer];
+  nextFadeBuffer ^= 1;
+  int32_t fromRoot = isqrt((uint32_t)fromDuty * BACKLIGHT_PWM_TOP);
+  int32_t toRoot = isqrt((uint32_t)duty * BACKLIGHT_PWM_TOP);
+  for (uint8_t i = 0; i < steps; i++) {
+    int32_t root = fromRoot + (toRoot - fromRoot) * (i + 1) / steps;
+    values[i] = (uint32_t)(root * root) / BACKLIGHT_PWM_TOP;  //Polarity bit clear, so the pin is low (on) for the first <value> counts
+  }
+  values[steps - 1] = duty;  //Exactly the target, whatever the rounding
+
+  NRF_PWM0->SEQ[0].PTR = (uint32_t)values;
+  NRF_PWM0->SEQ[0].CNT = steps;
+  NRF_PWM0->SEQ[0].REFRESH = periodsPerStep > 0 ? periodsPerStep - 1 : 0;
+  NRF_PWM0->SHORTS = duty == 0 ? PWM_SHORTS_SEQEND0_STOP_Msk : 0;  //Stop (and disable in the interrupt) once faded to off
+  NRF_PWM0->EVENTS_STOPPED = 0;
+  NRF_PWM0->ENABLE = PWM_ENABLE_ENABLE_Enabled << PWM_ENABLE_ENABLE_Pos;
+  NRF_PWM0->TASKS_SEQSTART[0] = 1;
+  backlightPWMRunning = true;
+}
+
+/* 
+  Get the duty the backlight is at now (part way through a fade, this is worked out from the time, as the CPU isn't told)
+ */
+uint16_t getBacklightDuty() {
+  uint32_t elapsed = RTC_TICK_DIFF(RTC_TICKS(), fadeStartTick);
+  if (elapsed >= fadeTicks)
+    return fadeToDuty;
+  int32_t fromRoot = isqrt((uint32_t)fadeFromDuty * BACKLIGHT_PWM_TOP);
+  int32_t toRoot = isqrt((uint32_t)fadeToDuty * BACKLIGHT_PWM_TOP);
+  int32_t root = fromRoot + (int32_t)((int64_t)(toRoot - fromRoot) * elapsed / fadeTicks);
+  return (uint32_t)(root * root) / BACKLIGHT_PWM_TOP;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void PWM0_IRQHandler() {
+  if (NRF_PWM0->EVENTS_STOPPED) {
+    NRF_PWM0->EVENTS_STOPPED = 0;
+    if (fadeToDuty != 0)  //A new fade was started just as the last one stopped
+      return;
+    //Faded to off, so hand the pins back to GPIO (high = off) and stop the PWM clock
+    NRF_PWM0->ENABLE = PWM_ENABLE_ENABLE_Disabled << PWM_ENABLE_ENABLE_Pos;
+    backlightPWMRunning = false;
+  }
+  (void)NRF_PWM0->EVENTS_STOPPED;
+}
+#ifdef __cplusplus
+}
+#endif
@@ -6,9 +6,54 @@ BLEService bleService = BLEService("190A");
 BLECharacteristic TXchar = BLECharacteristic("0002", BLENotify, 20);
 BLECharacteristic RXchar = BLECharacteristic("0001", BLEWriteWithoutResponse, 20);
 
+/* 
+  Print that sends what is written to it as notifications on TXchar, 20 bytes (one notification) at a time
+  This lets anything that can print to Serial (eg dumpPowerModel()) be sent over BLE instead
+  The SoftDevice only has a few notification buffers, so before each notification it polls the stack (which frees the
+  buffers of sent notifications) until one is free. If none frees up within BLE_NOTIFY_TIMEOUT_MS, or the central
+  disconnects, the rest of the output is dropped (until begin() is called again) rather than blocking the main loop
+ */
+class BLEPrint : public Print {
+ private:
+  uint8_t buf[20];
+  uint8_t length = 0;
+  bool failed = false;
+
+ public:
+  void begin() {
+    length = 0;
+    failed = false;
+  }
+  size_t write(uint8_t c) {
+    if (failed)
+      return 0;
+    buf[length++] = c;
+    if (length == sizeof(buf) || c == '\n')
+      flush();
+    return 1;
+  }
+  void flush() {
+    if (length == 0 || failed)
+      return;
+    uint32_t startTime = millis();
+    while (!TXchar.canNotify() || !TXchar.setValue(buf, length)) {
+      if (!blePeripheral.connected() || millis() - startTime > BLE_NOTIFY_TIMEOUT_MS) {
+        failed = true;
+        break;
+      }
+      blePeripheral.poll();
+    }
+    length = 0;
+  }
+};
+
+BLEPrint blePrint;
+bool powerModelDumpRequested = false;
+
 /* 
   Basically all code here was ripped from ATCWatch to enable the softdevice
   for power draw debugging. No work has been done on the bluetooth stack yet
+  Only started when BLE_ENABLED is defined (see bluetooth.h), the main loop then polls it
  */
 void initBluetooth() {
   blePeripheral.setLocalName("P8Watch");
@@ -25,8 +70,18 @@ void initBluetooth() {
   feedBle();
 }
 
+/* 
+  Poll the BLE stack, then send anything a command asked for
+  The sending is done here rather than in the write handler, as it polls the stack itself (see BLEPrint)
+ */
 void feedBle() {
   blePeripheral.poll();
+  if (powerModelDumpRequested) {
+    powerModelDumpRequested = false;
+    blePrint.begin();
+    dumpPowerModel(blePrint);
+    blePrint.flush();
+  }
 }
 
 void connectHandler(BLECentral& central) {
@@ -37,6 +92,12 @@ void disconnectHandler(BLECentral& central) {
   ledPing();
 }
 
+/* 
+  Commands are single characters written to RXchar
+  'P' = dump the power model (see powerModel.cpp)
+ */
 void writeHandler(BLECentral& central, BLECharacteristic& characteristic) {
   ledPing();
+  if (characteristic.valueLength() > 0 && characteristic.value()[0] == BLE_COMMAND_POWER_MODEL)
+    powerModelDumpRequested = true;  //Sent by feedBle()
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "headers/boot.h"
+
+#include "headers/button.h"
+#include "headers/deepSleep.h"
+#include "headers/display.h"
+#include "headers/fastSPI.h"
+#include "headers/governor.h"
+#include "headers/interrupts.h"
+#include "headers/ioControl.h"
+#include "headers/powerControl.h"
+#include "headers/screenController.h"
+#include "headers/touch.h"
+#include "headers/twim.h"
+#include "headers/watchdog.h"
+
+/*
+  Boot sequencer
+  Rather than running each init function one after another (each sitting through its own delays), every stage lists
+  the stages it depends on. A stage is started as soon as its dependencies have finished, so stages that don't depend
+  on each other (eg the display and touch controller resets) wait at the same time, and the time screen is shown as
+  soon as the display is ready, without waiting for the rest
+  The start and end of every stage is recorded in retained RAM (see retained.h), so a slow boot can be inspected
+  after the next reset
+ */
+
+static CoTask* bootIO() {
+  initIO();
+  return NULL;
+}
+
+static CoTask* bootWatchdog() {
+  initWatchdog();
+  return NULL;
+}
+
+static CoTask* bootSPI() {
+  initFastSPI();
+  return NULL;
+}
+
+static CoTask* bootDisplay() {
+  return isFastRestore() ? restoreDisplay() : initDisplay();
+}
+
+static CoTask* bootTWIM() {
+  initTWIM();
+  return NULL;
+}
+
+static CoTask* bootInterrupts() {
+  initButton();
+  initInterrupts();
+  return NULL;
+}
+
+static CoTask* bootSleep() {
+  initSleep();
+  initDeepSleep();
+  initGovernor();  //Sets the sleep timeout, backlight limit and battery period, so needs the sleep and IO tasks
+  addGPIOEventSource(POWER_INDICATION, EVENT_SOURCE_CHARGER, EDGE_MASK_BOTH);  //Only once the governor can handle it
+  return NULL;
+}
+
+static CoTask* bootScreen() {
+  if (isFastRestore()) {
+    restoreSnapshot();
+    initScreen();
+    refreshScreenNow();
+    displayOn();  //The restored display was only taken out of sleep, so it is turned on once the first frame is drawn
+    showToast("Time was paused");
+  } else {
+    initScreen();
+  }
+  return NULL;
+}
+
+const BootStage bootStages[NUM_BOOT_STAGES] = {
+    {bootIO, 0},                                                                    //BOOT_STAGE_IO
+    {bootWatchdog, 0},                                                              //BOOT_STAGE_WATCHDOG
+    {bootSPI, BOOT_STAGE_BIT(BOOT_STAGE_IO)},                                       //BOOT_STAGE_SPI
+    {bootDisplay, BOOT_STAGE_BIT(BOOT_STAGE_SPI)},                                  //BOOT_STAGE_DISPLAY
+    {bootTWIM, 0},                                                                  //BOOT_STAGE_TWIM
+    {initTouch, BOOT_STAGE_BIT(BOOT_STAGE_IO) | BOOT_STAGE_BIT(BOOT_STAGE_TWIM)},  //BOOT_STAGE_TOUCH
+    {bootInterrupts, BOOT_STAGE_BIT(BOOT_STAGE_TOUCH)},                             //BOOT_STAGE_INTERRUPTS
+    {bootSleep, BOOT_STAGE_BIT(BOOT_STAGE_IO) | BOOT_STAGE_BIT(BOOT_STAGE_INTERRUPTS)},  //BOOT_STAGE_SLEEP
+    {bootScreen, BOOT_STAGE_BIT(BOOT_STAGE_DISPLAY) | BOOT_STAGE_BIT(BOOT_STAGE_IO)},  //BOOT_STAGE_SCREEN
+    {initAccel, BOOT_STAGE_BIT(BOOT_STAGE_TWIM) | BOOT_STAGE_BIT(BOOT_STAGE_INTERRUPTS)},  //BOOT_STAGE_ACCEL
+};
+
+uint16_t bootStagesStarted = 0;
+uint16_t bootStagesFinished = 0;
+CoTask* bootStageTasks[NUM_BOOT_STAGES];
+
+/* 
+  Start every stage whose dependencies have finished, and record the stages that have finished
+  Returns true if any stage finished (so more stages might be able to start)
+ */
+static bool updateBootStages() {
+  bool stageFinished = false;
+  for (uint8_t stage = 0; stage < NUM_BOOT_STAGES; stage++) {
+    uint16_t bit = BOOT_STAGE_BIT(stage);
+    if (!(bootStagesStarted & bit) && (bootStages[stage].dependencies & bootStagesFinished) == bootStages[stage].dependencies) {
+      bootStagesStarted |= bit;
+      retained.boot.stageStartTick[stage] = RTC_TICKS();
+      bootStageTasks[stage] = bootStages[stage].function();
+    }
+    if ((bootStagesStarted & bit) && !(bootStagesFinished & bit) && (bootStageTasks[stage] == NULL || !isCoroutineRunning(bootStageTasks[stage]))) {
+      bootStagesFinished |= bit;
+      retained.boot.stageEndTick[stage] = RTC_TICKS();
+      if (stage == BOOT_STAGE_SCREEN)
+        retained.boot.firstFrameTick = retained.boot.stageEndTick[stage];
+      stageFinished = true;
+    }
+  }
+  return stageFinished;
+}
+
+/* 
+  Run every boot stage, sleeping whilst all of the started stages are waiting
+  Returns once every stage has finished
+ */
+void runBootSequence() {
+  const uint16_t allStages = (1 << NUM_BOOT_STAGES) - 1;
+  while (true) {
+    while (updateBootStages())
+      ;
+    if (bootStagesFinished == allStages)
+      return;
+    runScheduledTasks();
+    runCoroutines();
+    if (!updateBootStages())  //Only sleep if nothing finished whilst the coroutines ran
+      sleepWait();
+  }
+}
+
+/* 
+  Get the time from boot to the first screen being drawn in ms
+ */
+uint32_t getBootToFirstFrameMS() {
+  return RTC_TICKS_TO_MS(retained.boot.firstFrameTick);
+}
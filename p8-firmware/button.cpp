@@ -0,0 +1,117 @@
+#include "headers/button.h"
+
+#include "headers/interrupts.h"
+#include "headers/powerControl.h"
+#include "headers/screenController.h"
+
+/*
+  Button debouncing and press classification
+  The GPIOTE interrupt handler already timestamps every edge of the button (see interrupts.cpp), so debouncing is
+  done on the timestamps rather than by waiting: the first edge is acted on straight away, and any edge within
+  BUTTON_DEBOUNCE_MS of it is bounce and ignored. Because the last real edge might be hidden in the bounce, a scheduler
+  task re-reads the pin once the bounce window has passed and makes up the edge if the level doesn't match
+  Long presses and hold repeats are also scheduler deadlines, so nothing ever busy waits or polls the button
+ */
+
+bool buttonDown = false;
+bool buttonPressConsumed = false;  //The press woke the watch, so it isn't classified
+bool buttonLongReported = false;
+uint8_t buttonClickCount = 0;      //1 for a single press, 2 for the second press of a double press
+uint32_t lastButtonEdgeTick = 0;   //RTC tick of the last accepted edge
+uint32_t lastButtonReleaseTick = 0;
+
+uint8_t buttonSettleTask = NO_TASK;
+uint8_t buttonLongPressTask = NO_TASK;
+
+static void buttonSettleCheck();
+static void buttonLongPressCheck();
+
+/* 
+  Register the button's scheduler tasks (must be after initScheduler())
+ */
+void initButton() {
+  buttonDown = getButtonState();
+  buttonPressConsumed = buttonDown;  //A press that started before boot (eg the one that woke the watch from System OFF) isn't classified
+  buttonSettleTask = addTask(buttonSettleCheck, 0, 0, TASK_ALWAYS);
+  cancelTask(buttonSettleTask);
+  buttonLongPressTask = addTask(buttonLongPressCheck, 0, 0);
+  cancelTask(buttonLongPressTask);
+}
+
+/* 
+  Handle an edge of the button (EDGE_RISING = pressed, the button is active high) at the given RTC tick
+  Called by the interrupt dispatcher for every button edge
+ */
+void buttonEdge(uint8_t edge, uint32_t tick) {
+  bool pressed = edge == EDGE_RISING;
+  if (pressed == buttonDown)  //Already in this state (the settle check made up this edge already)
+    return;
+  if (RTC_TICK_DIFF(tick, lastButtonEdgeTick) < MS_TO_RTC_TICKS(BUTTON_DEBOUNCE_MS)) {
+    scheduleTask(buttonSettleTask, BUTTON_DEBOUNCE_MS + 1);  //Check the real level once the bouncing is over
+    return;
+  }
+  lastButtonEdgeTick = tick;
+  buttonDown = pressed;
+  updateLastWakeTime();
+
+  if (pressed) {
+    if (getPowerMode() == POWER_OFF) {  //A press whilst asleep just wakes the watch
+      buttonPressConsumed = true;
+      exitSleep(tick);
+      return;
+    }
+    wakeTouch();  //In case the watch was woken without it (see exitSleep())
+    buttonPressConsumed = false;
+    buttonLongReported = false;
+    if (buttonClickCount == 1 && RTC_TICK_DIFF(tick, lastButtonReleaseTick) < MS_TO_RTC_TICKS(BUTTON_DOUBLE_PRESS_MS))
+      buttonClickCount = 2;
+    else
+      buttonClickCount = 1;
+    scheduleTask(buttonLongPressTask, BUTTON_LONG_PRESS_MS);
+    return;
+  }
+
+  //Released
+  cancelTask(buttonLongPressTask);
+  lastButtonReleaseTick = tick;
+  if (buttonPressConsumed) {
+    buttonPressConsumed = false;
+    buttonClickCount = 0;
+    return;
+  }
+  if (buttonLongReported) {
+    buttonClickCount = 0;
+  } else if (buttonClickCount == 2) {
+    buttonClickCount = 0;
+    handleButtonAction(BUTTON_DOUBLE_PRESS);
+  } else {
+    handleButtonAction(BUTTON_SHORT_PRESS);
+  }
+}
+
+/* 
+  Scheduler task run just after a bounce window, makes up the last edge if it was lost in the bounce
+ */
+static void buttonSettleCheck() {
+  bool pressed = getButtonState();
+  if (pressed != buttonDown)
+    buttonEdge(pressed ? EDGE_RISING : EDGE_FALLING, RTC_TICKS());
+}
+
+/* 
+  Scheduler task run BUTTON_LONG_PRESS_MS after a press, and then every BUTTON_REPEAT_MS whilst it is held
+ */
+static void buttonLongPressCheck() {
+  if (!buttonDown || buttonPressConsumed)
+    return;
+  handleButtonAction(buttonLongReported ? BUTTON_HELD : BUTTON_LONG_PRESS);
+  buttonLongReported = true;
+  scheduleTask(buttonLongPressTask, BUTTON_REPEAT_MS);
+}
+
+/* 
+  Get the debounced state of the button
+ */
+bool isButtonDown() {
+  return buttonDown;
+}
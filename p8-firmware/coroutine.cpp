@@ -0,0 +1,197 @@
+#include "headers/coroutine.h"
+
+#include "headers/powerControl.h"
+
+/*
+  Runner for the stackless coroutines (see coroutine.h)
+  Every running coroutine is resumed once per pass of the main loop. A coroutine waiting on an I2C or SPI transfer or a pin
+  is woken by that peripheral's interrupt (any interrupt wakes the CPU and runs the main loop), and a coroutine waiting on a delay
+  is woken by a scheduler task set to the soonest delay deadline, so no coroutine ever needs the CPU to poll
+ */
+
+CoTask* coroutines[MAX_COROUTINES];
+uint8_t coroutineWakeTask = NO_TASK;
+
+/* 
+  Register the scheduler task used to wake the CPU at the end of a delay (must be after initScheduler())
+ */
+void initCoroutines() {
+  coroutineWakeTask = addTask(runCoroutines, 0, 0, TASK_ALWAYS);
+  cancelTask(coroutineWakeTask);
+}
+
+/* 
+  Forget the I2C transaction the coroutine is waiting on (if any), so its completion is ignored when it arrives
+  Every coroutine transaction has the same bus priority, so they finish in the order they were queued, and the stale
+  completions always arrive before the completion of anything the coroutine queues next
+ */
+static void abandonI2C(CoTask* co) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();  //The completion could otherwise arrive between the check and the count
+  if (co->i2cState == CO_I2C_PENDING)
+    co->staleI2CCompletions++;
+  co->i2cState = CO_I2C_IDLE;
+  __set_PRIMASK(primask);
+}
+
+/* 
+  Start a coroutine from the beginning (if it is already running, it is restarted)
+  Returns false if too many coroutines are running
+ */
+bool startCoroutine(CoTask* co, CoFunction function) {
+  co->function = function;
+  co->resumeLine = 0;
+  co->delaying = false;
+  abandonI2C(co);
+  if (co->running)
+    return true;
+  for (uint8_t i = 0; i < MAX_COROUTINES; i++) {
+    if (coroutines[i] == NULL) {
+      coroutines[i] = co;
+      co->running = true;
+      scheduleTask(coroutineWakeTask, 0);  //Run it on the next pass of the main loop
+      return true;
+    }
+  }
+  return false;
+}
+
+/* 
+  Check whether a coroutine has finished
+ */
+bool isCoroutineRunning(CoTask* co) {
+  return co->running;
+}
+
+/* 
+  Stop a coroutine where it is (an I2C transaction it queued will still finish, but nothing waits on it)
+ */
+void cancelCoroutine(CoTask* co) {
+  abandonI2C(co);
+  for (uint8_t i = 0; i < MAX_COROUTINES; i++) {
+    if (coroutines[i] == co)
+      coroutines[i] = NULL;
+  }
+  co->running = false;
+  co->delaying = false;
+}
+
+/* 
+  Resume every running coroutine, then set the wake task to the end of the soonest delay
+  Called from the main loop (and by the wake task)
+ */
+void runCoroutines() {
+  bool delaying = false;
+  int32_t soonest = 0;
+  for (uint8_t i = 0; i < MAX_COROUTINES; i++) {
+    CoTask* co = coroutines[i];
+    if (co == NULL)
+      continue;
+    if (co->function(co) == CO_DONE) {
+      co->running = false;
+      coroutines[i] = NULL;
+      continue;
+    }
+    if (co->delaying) {
+      int32_t remaining = ((int32_t)(RTC_TICK_DIFF(co->wakeTick, SCHEDULER_TICKS()) << 8)) >> 8;
+      if (!delaying || remaining < soonest) {
+        soonest = remaining;
+        delaying = true;
+      }
+    }
+  }
+  if (delaying)
+    scheduleTaskAt(coroutineWakeTask, SCHEDULER_TICKS() + (soonest > 0 ? soonest : 0));
+  else
+    cancelTask(coroutineWakeTask);
+}
+
+/* 
+  Run the coroutines (and scheduled tasks) until the given one has finished, sleeping between passes
+  Only for setup code, before the main loop is running (other coroutines keep running too)
+ */
+void waitForCoroutine(CoTask* co) {
+  while (co->running) {
+    runScheduledTasks();
+    runCoroutines();
+    if (co->running)
+      sleepWait();
+  }
+}
+
+/* 
+  Used by CO_DELAY_MS, starts the delay the first time and returns true once it has passed
+ */
+bool coDelay(CoTask* co, uint32_t ms) {
+  if (!co->delaying) {
+    co->delaying = true;
+    co->wakeTick = (SCHEDULER_TICKS() + MS_TO_RTC_TICKS(ms)) & 0xFFFFFF;
+    return false;
+  }
+  if ((((int32_t)(RTC_TICK_DIFF(co->wakeTick, SCHEDULER_TICKS()) << 8)) >> 8) > 0)
+    return false;
+  co->delaying = false;
+  return true;
+}
+
+/* 
+  I2C completion callback, context is the coroutine waiting on the transaction
+ */
+static void coI2CComplete(bool success, void* context) {
+  CoTask* co = (CoTask*)context;
+  if (co->staleI2CCompletions > 0) {  //Queued by a run that has since been restarted or cancelled
+    co->staleI2CCompletions--;
+    return;
+  }
+  co->i2cSuccess = success;
+  co->i2cState = CO_I2C_DONE;
+}
+
+/* 
+  Used by CO_AWAIT_I2C_WRITE, queues the write the first time (retrying if the queue is full) and returns true once it is done
+  The data is copied when it is queued, so it only needs to be valid on the pass that queues it
+ */
+bool coI2CWriteRegisters(CoTask* co, uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length) {
+  if (co->i2cState == CO_I2C_IDLE) {
+    co->i2cState = CO_I2C_PENDING;
+    if (!i2cWriteRegisters(address, reg, data, length, I2C_PRIORITY_BACKGROUND, coI2CComplete, co))
+      co->i2cState = CO_I2C_IDLE;
+    return false;
+  }
+  if (co->i2cState == CO_I2C_PENDING)
+    return false;
+  co->i2cState = CO_I2C_IDLE;
+  return true;
+}
+
+/* 
+  Used by CO_AWAIT_I2C_READ, rxBuf must stay valid until the read is done
+ */
+bool coI2CReadRegisters(CoTask* co, uint8_t address, uint8_t reg, uint8_t* rxBuf, uint8_t length) {
+  if (co->i2cState == CO_I2C_IDLE) {
+    co->i2cState = CO_I2C_PENDING;
+    if (!i2cReadRegisters(address, reg, rxBuf, length, I2C_PRIORITY_BACKGROUND, coI2CComplete, co))
+      co->i2cState = CO_I2C_IDLE;
+    return false;
+  }
+  if (co->i2cState == CO_I2C_PENDING)
+    return false;
+  co->i2cState = CO_I2C_IDLE;
+  return true;
+}
+
+/* 
+  Used by CO_AWAIT_I2C_TRANSFER, for writes too long to be copied (both buffers must be in RAM and stay valid until it is done)
+ */
+bool coI2CTransfer(CoTask* co, uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength) {
+  if (co->i2cState == CO_I2C_IDLE) {
+    co->i2cState = CO_I2C_PENDING;
+    if (!i2cTransfer(address, txBuf, txLength, rxBuf, rxLength, I2C_PRIORITY_BACKGROUND, coI2CComplete, co))
+      co->i2cState = CO_I2C_IDLE;
+    return false;
+  }
+  if (co->i2cState == CO_I2C_PENDING)
+    return false;
+  co->i2cState = CO_I2C_IDLE;
+  return true;
+}
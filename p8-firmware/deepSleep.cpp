@@ -0,0 +1,119 @@
+#include "headers/deepSleep.h"
+
+#include "headers/accelerometer.h"
+#include "headers/ioControl.h"
+#include "headers/powerControl.h"
+#include "headers/ramRetention.h"
+#include "headers/screenController.h"
+#include "headers/touch.h"
+
+/*
+  Deep sleep (System OFF)
+  Normal sleep keeps the CPU in System ON so the RTC, scheduler and GPIOTE keep running. When deep sleep is picked on the
+  power screen (or with DEEP_SLEEP_AUTO, once the watch has been asleep for DEEP_SLEEP_AFTER_MS with a low battery), it
+  goes into System OFF instead, where everything but the GPIO sense is off and only the button can wake it. As the clock
+  stops and raise and double tap wakes stop working, switching off on its own is opt in
+  Waking from System OFF is a reset, so before switching off the state that matters is saved into the retained RAM
+  snapshot (and only the RAM sections holding it are kept). The boot after the wake (RESETREAS.OFF with a valid snapshot)
+  is a fast restore: the bootloader button check is skipped (the button is being held), the display is only taken out of
+  sleep rather than reset, configured and cleared (it stays powered whilst the watch is off), and the restored screen is
+  drawn before the display is turned on. The wake to time on screen latency is the boot to first frame time on the info screen
+  No clock runs in System OFF, so the time carries on from when the watch was switched off
+ */
+
+bool fastRestore = false;
+uint8_t switchOffTask = NO_TASK;
+
+/* 
+  Register the task that switches the watch off, and the one that checks how long the watch has been asleep (if enabled)
+ */
+void initDeepSleep() {
+  switchOffTask = addTask(switchOff, 0, 0, TASK_ALWAYS);
+  cancelTask(switchOffTask);  //Only scheduled by enterDeepSleep()
+#ifdef DEEP_SLEEP_AUTO
+  addTask(deepSleepCheck, DEEP_SLEEP_CHECK_MS, DEEP_SLEEP_CHECK_MS, TASK_ALWAYS);
+#endif
+}
+
+/* 
+  Scheduler task that switches the watch off once it has been asleep for long enough with a low battery
+  (never whilst charging, as there is no battery to save)
+ */
+void deepSleepCheck() {
+  if (getPowerMode() == POWER_ON || getChargeState() || getBatteryPercent() > DEEP_SLEEP_MAX_BATTERY_PERCENT)
+    return;
+  if ((uint32_t)(millis() - getLastWakeTime()) >= DEEP_SLEEP_AFTER_MS)
+    enterDeepSleep();
+}
+
+/* 
+  Work out whether this boot is a wake from System OFF with a snapshot to restore, called straight after initRetained()
+ */
+void checkFastRestore() {
+  fastRestore = (retained.resetReason & POWER_RESETREAS_OFF_Msk) && retained.snapshot.valid == SNAPSHOT_MAGIC;
+}
+
+/* 
+  Check whether this boot is restoring a snapshot (stays true for the whole boot)
+ */
+bool isFastRestore() {
+  return fastRestore;
+}
+
+/* 
+  Restore the saved state (called by the boot before the first screen is set up)
+ */
+void restoreSnapshot() {
+  DeepSleepSnapshot* snapshot = &retained.snapshot;
+  setTime(snapshot->time);
+  setBrightness(snapshot->brightness);
+  setHomeScreenIndex(snapshot->screenIndex);
+  snapshot->valid = 0;  //Only restored once, a later reset is a normal boot
+}
+
+/* 
+  Put the display, touch controller and accelerometer to sleep, then switch off once the touch controller is asleep
+  (see switchOff()). Only the button can wake the watch, which resets it
+ */
+void enterDeepSleep() {
+  if (getPowerMode() == POWER_ON)
+    enterSleep();  //Sends the touch controller its sleep command if it is awake, it already is asleep otherwise
+  scheduleTask(switchOffTask, 0);
+}
+
+/* 
+  Scheduler task that saves the state and switches off
+  The touch controller stays powered, so its sleep sequence must have finished first. Rather than blocking the main
+  loop until it has, the task checks again every DEEP_SLEEP_WAIT_MS. A wake in the meantime (eg the button) cancels it
+ */
+void switchOff() {
+  if (getPowerMode() == POWER_ON)
+    return;
+  if (isTouchSequenceRunning()) {
+    scheduleTask(switchOffTask, DEEP_SLEEP_WAIT_MS);
+    return;
+  }
+  sleepAccel();  //The accelerometer stays powered too
+
+  DeepSleepSnapshot* snapshot = &retained.snapshot;
+  snapshot->time = now();
+  snapshot->brightness = getBrightness();
+  snapshot->screenIndex = getHomeScreenIndex();
+  snapshot->valid = SNAPSHOT_MAGIC;
+  retainRAMInSystemOff(&retained, sizeof(retained));
+
+  //Any pin with sense enabled wakes the chip from System OFF, so only the button is left
+  for (uint8_t pin = 0; pin < 32; pin++)
+    NRF_GPIO->PIN_CNF[pin] &= ~GPIO_PIN_CNF_SENSE_Msk;
+  NRF_GPIO->PIN_CNF[PUSH_BUTTON_IN] |= (GPIO_PIN_CNF_SENSE_High << GPIO_PIN_CNF_SENSE_Pos);  //The button is active high
+  NRF_GPIO->LATCH = NRF_GPIO->LATCH;  //A pin left latched (see interrupts.cpp) would wake the chip straight away
+
+  uint8_t softdeviceEnabled = 0;
+  sd_softdevice_is_enabled(&softdeviceEnabled);
+  if (softdeviceEnabled)
+    sd_power_system_off();
+  else
+    NRF_POWER->SYSTEMOFF = 1;
+  while (true)  //System OFF is emulated whilst a debugger is attached, so don't carry on
+    __WFE();
+}
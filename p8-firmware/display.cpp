@@ -5,25 +5,115 @@ uint8_t lcdBuffer[LCD_BUFFER_SIZE + 4];
 uint32_t windowArea = 0;
 uint32_t windowWidth = 0;
 uint32_t windowHeight = 0;
+CoTask displayInitTask;
+bool displayReady = false;
+
+static void sendDisplayConfig();
+static void initDisplayPins();
 
 /*
   Initialize display
+  The reset and power up of the display needs about 300ms of waiting, so it is done by a coroutine (see coroutine.h)
+  rather than blocking. Returns the coroutine, which is finished when the display is ready
+  Nothing else may draw to the display until then
 */
-void initDisplay() {
-  uint8_t buf[25];
+CoTask* initDisplay() {
+  initDisplayPins();
+  startCoroutine(&displayInitTask, displayInitSequence);
+  return &displayInitTask;
+}
+
+/*
+  Used in place of initDisplay() when waking from System OFF (see deepSleep.cpp)
+  The display stays powered whilst the watch is off, so it keeps its configuration and only needs to be taken out of sleep
+  It is left off, so the first frame can be drawn before displayOn() is called
+*/
+CoTask* restoreDisplay() {
+  initDisplayPins();
+  startCoroutine(&displayInitTask, displayRestoreSequence);
+  return &displayInitTask;
+}
+
+/*
+  Set up the display's control pins (the reset pin is driven high straight away, so the display isn't reset)
+*/
+static void initDisplayPins() {
+  digitalWrite(LCD_RESET, HIGH);
   pinMode(LCD_CS, OUTPUT);     //Chip select
   pinMode(LCD_RS, OUTPUT);     //Command/data select
   pinMode(LCD_RESET, OUTPUT);  //Display reset
   pinMode(LCD_DET, OUTPUT);    //?
   digitalWrite(LCD_CS, HIGH);  //Disable display SPI communication (active low)
   digitalWrite(LCD_RS, HIGH);  //Data/command selector
+  addScratchRAM(lcdBuffer, sizeof(lcdBuffer));  //Only used whilst awake, so it is switched off whilst asleep
+}
+
+/*
+  Check whether the display has finished initializing
+*/
+bool isDisplayReady() {
+  return displayReady;
+}
+
+/*
+  Coroutine that takes the display out of sleep after System OFF, ready to be drawn to
+*/
+uint8_t displayRestoreSequence(CoTask* co) {
+  CO_BEGIN(co);
+  displayReady = false;
+  displaySleepOut();
+  CO_DELAY_MS(co, DISPLAY_SLEEP_OUT_MS);
+  displayReady = true;
+  CO_END(co);
+}
+
+/*
+  Coroutine that resets the display, configures it, turns it on and clears it
+*/
+uint8_t displayInitSequence(CoTask* co) {
+  static uint32_t clearBytesLeft;
+  uint32_t chunk;
+  CO_BEGIN(co);
+  displayReady = false;
   //Reset display to get into known state
   digitalWrite(LCD_RESET, HIGH);
-  delay(20);
+  CO_DELAY_MS(co, 20);
   digitalWrite(LCD_RESET, LOW);
-  delay(100);
+  CO_DELAY_MS(co, 100);
   digitalWrite(LCD_RESET, HIGH);
-  delay(100);
+  CO_DELAY_MS(co, 100);
+  sendDisplayConfig();
+  preWrite();
+  sendSPICommand(0x11);  //Sleep mode off (needs 5msec wait for voltage stabalization)
+  postWrite();
+  setPowerState(POWER_CONSUMER_DISPLAY, POWER_STATE_ACTIVE);
+  CO_DELAY_MS(co, 30);
+  preWrite();
+  sendSPICommand(0x29);  //Display on
+  postWrite();
+  CO_DELAY_MS(co, 30);
+  //Clear the display in LCD buffer sized chunks, without waiting for each chunk to be sent
+  memset(lcdBuffer, 0x00, LCD_BUFFER_SIZE);
+  preWrite();
+  setDisplayWriteRegion({0, 0}, 240, 240);
+  sendSPICommand(0x2C);  //Memory write
+  clearBytesLeft = 240 * 240 * 2;
+  while (clearBytesLeft > 0) {
+    chunk = clearBytesLeft > LCD_BUFFER_SIZE ? LCD_BUFFER_SIZE : clearBytesLeft;
+    writeSPIAsync(lcdBuffer, chunk);
+    clearBytesLeft -= chunk;
+    CO_AWAIT_SPI(co);
+  }
+  postWrite();
+  displayReady = true;
+  CO_END(co);
+}
+
+/*
+  Send the display configuration (everything between the reset and sleep out)
+*/
+static void sendDisplayConfig() {
+  uint8_t buf[25];
   preWrite();
   sendSPICommand(0x36);  //Memory data access control
   /*
@@ -73,22 +163,27 @@ void initDisplay() {
   uint8_t gammaNeg[] = {208, 4, 12, 17, 19, 44, 63, 68, 81, 47, 31, 31, 32, 35};
   writeSPI(gammaNeg, 14);
   sendSPICommand(0x21);  //Display inversion on
-  sendSPICommand(0x11);  //Sleep mode off (needs 5msec wait for voltage stabalization)
-  delay(30);
-  sendSPICommand(0x29);  //Display on
-  delay(30);
-  clearDisplay();
   postWrite();
 }
 
 /* 
-  Wake display
+  Take the display out of sleep, but leave it showing nothing
+  Nothing else may be sent to the display (including drawing) until DISPLAY_SLEEP_OUT_MS later
  */
-void wakeDisplay() {
+void displaySleepOut() {
   preWrite();
-  sendSPICommand(0x29);  //Display on
   sendSPICommand(0x11);  //Sleep out
   postWrite();
+  setPowerState(POWER_CONSUMER_DISPLAY, POWER_STATE_ACTIVE);
+}
+
+/* 
+  Start showing the contents of display memory
+ */
+void displayOn() {
+  preWrite();
+  sendSPICommand(0x29);  //Display on
+  postWrite();
 }
 
 /* 
@@ -99,6 +194,7 @@ void sleepDisplay() {
   sendSPICommand(0x28);  //Display off
   sendSPICommand(0x10);  //Sleep in
   postWrite();
+  setPowerState(POWER_CONSUMER_DISPLAY, POWER_STATE_IDLE);
 }
 
 /*
@@ -327,6 +423,13 @@ void setDisplayWriteRegion(coord pos, uint32_t w, uint32_t h) {
   writeSPI(buf, 4);
 }
 
+/*
+  Check whether two rectangles overlap (used to work out what needs redrawing under an overlay)
+*/
+bool rectsOverlap(coord aPos, uint32_t aW, uint32_t aH, coord bPos, uint32_t bW, uint32_t bH) {
+  return aPos.x < bPos.x + bW && bPos.x < aPos.x + aW && aPos.y < bPos.y + bH && bPos.y < aPos.y + aH;
+}
+
 /*
   Clear display (clear whole display when no arg (or false) is passed in)
 */
@@ -334,6 +437,94 @@ void clearDisplay(bool leaveAppDrawer) {
   drawFilledRect({0, 0}, 240, leaveAppDrawer ? 213 : 240, 0x0000);
 }
 
+/*
+  Hardware scrolling
+  The display controller has 320 lines of memory, of which we see the first 240. The memory can be split into a top fixed area,
+  a scrolling area and a bottom fixed area. Lines in the scrolling area are shown starting from the scroll start line,
+  wrapping around at the end of the area, so changing the start line moves the whole area without rewriting any pixels
+  (only the newly exposed lines need drawing). Everything outside the scrolling area (ie the app drawer) doesn't move
+*/
+uint16_t scrollStartLine = 0;
+
+void setScrollArea(uint16_t topFixedLines, uint16_t scrollLines) {
+  uint16_t bottomFixedLines = 320 - topFixedLines - scrollLines;
+  uint8_t buf[6] = {(uint8_t)(topFixedLines >> 8), (uint8_t)topFixedLines, (uint8_t)(scrollLines >> 8), (uint8_t)scrollLines, (uint8_t)(bottomFixedLines >> 8), (uint8_t)bottomFixedLines};
+  preWrite();
+  sendSPICommand(0x33);  //Vertical scrolling definition
+  writeSPI(buf, 6);
+  postWrite();
+}
+
+/*
+  Set the memory line that is shown at the top of the scrolling area
+*/
+void setScrollStart(uint16_t line) {
+  scrollStartLine = line;
+  uint8_t buf[2] = {(uint8_t)(line >> 8), (uint8_t)line};
+  preWrite();
+  sendSPICommand(0x37);  //Vertical scrolling start address
+  writeSPI(buf, 2);
+  postWrite();
+}
+
+/*
+  Get the memory line shown at the top of the scrolling area (0 when nothing is scrolled)
+*/
+uint16_t getScrollStart() {
+  return scrollStartLine;
+}
+
+/*
+  Go back to the whole memory scrolling with no offset (ie no scrolling)
+*/
+void resetScroll() {
+  setScrollArea(0, 320);
+  setScrollStart(0);
+}
+
+/*
+  Draw some rows of a full width band containing a string, for drawing the part of a list item that has just scrolled into view
+  Only rows [firstRow, firstRow + numRows) of the band are rendered and sent, and they are written to display memory starting at memoryLine
+  Unlike drawChar(), nothing outside of those rows is touched, so a band can be drawn in pieces without overwriting
+  whatever is above or below it. numRows must fit in the LCD buffer (31 rows)
+*/
+void drawStringRows(coord textPos, uint8_t pixelsPerPixel, char* string, uint16_t colourFG, uint16_t colourBG, uint8_t firstRow, uint8_t numRows, uint8_t memoryLine) {
+  if (numRows == 0 || numRows * 240 * 2 > LCD_BUFFER_SIZE)
+    return;
+  //Fill the rows with the background colour
+  for (uint32_t i = 0; i < numRows * 240 * 2; i += 2) {
+    lcdBuffer[i] = (colourBG >> 8) & 0xFF;
+    lcdBuffer[i + 1] = colourBG & 0xFF;
+  }
+  int offset = FONT_NEEDS_OFFSET ? 32 : 0;
+  int charX = textPos.x;
+  for (int i = 0; string[i] != 0 && charX + FONT_WIDTH * pixelsPerPixel <= 240; i++) {
+    for (int col = 0; col < FONT_WIDTH; col++) {
+      for (int fontRow = 0; fontRow < FONT_HEIGHT; fontRow++) {
+        if (!((font[string[i] - offset][col] >> fontRow) & 1))
+          continue;
+        //Write the scaled pixel, skipping any of its rows that aren't being drawn
+        for (int py = 0; py < pixelsPerPixel; py++) {
+          int bandRow = textPos.y + fontRow * pixelsPerPixel + py;
+          if (bandRow < firstRow || bandRow >= firstRow + numRows)
+            continue;
+          for (int px = 0; px < pixelsPerPixel; px++) {
+            int index = 2 * ((bandRow - firstRow) * 240 + charX + col * pixelsPerPixel + px);
+            lcdBuffer[index] = (colourFG >> 8) & 0xFF;
+            lcdBuffer[index + 1] = colourFG & 0xFF;
+          }
+        }
+      }
+    }
+    charX += FONT_WIDTH * pixelsPerPixel + pixelsPerPixel;
+  }
+  preWrite();
+  setDisplayWriteRegion({0, memoryLine}, 240, numRows);
+  sendSPICommand(0x2C);
+  writeSPI(lcdBuffer, numRows * 240 * 2);
+  postWrite();
+}
+
 
 //===================================
 //========*Testing Ground*===========
@@ -0,0 +1,132 @@
+#include "headers/drag.h"
+
+/* 
+  Tracks a finger from the streamed touch coordinates (see TOUCH_MODE_STREAM) and turns it into drags and flings
+  Whilst the finger is down the movement since the last sample is given to the screen, and the vertical velocity
+  is estimated with a simple moving average of the speed between samples (in pixels per second)
+  When the finger is lifted quickly the list keeps moving (a fling), slowing down exponentially like a real object with friction
+  All times are RTC ticks (see RTC_TICKS()), which are taken in the interrupt handler so that the velocity isn't
+  affected by how long the main loop took to get to the sample
+ */
+
+bool dragging = false;
+uint8_t dragStartX, dragStartY;
+uint8_t dragLastX, dragLastY;
+uint32_t dragLastTick;
+int32_t dragVelocity = 0;  //Vertical velocity in pixels per second
+
+bool kineticScrolling = false;
+int32_t kineticVelocity = 0;  //Pixels per second in Q8 (1/256ths), so slow flings still decay
+int32_t kineticRemainder = 0; //Fractional pixels (1/256ths) not yet scrolled
+uint32_t kineticLastTick;
+
+/* 
+  Finger has been put down, stop any fling that was happening (like catching a moving list)
+ */
+void dragTouchDown(uint8_t x, uint8_t y, uint32_t tick) {
+  dragging = true;
+  dragStartX = dragLastX = x;
+  dragStartY = dragLastY = y;
+  dragLastTick = tick;
+  dragVelocity = 0;
+  stopKineticScroll();
+}
+
+/* 
+  Finger has moved, returns the vertical movement since the last sample (and the horizontal movement in dx)
+ */
+int16_t dragTouchMove(uint8_t x, uint8_t y, uint32_t tick, int16_t* dx) {
+  if (!dragging) {  //If we missed the down event, start tracking from here
+    dragTouchDown(x, y, tick);
+    *dx = 0;
+    return 0;
+  }
+  int16_t dy = (int16_t)y - dragLastY;
+  *dx = (int16_t)x - dragLastX;
+  uint32_t dt = RTC_TICK_DIFF(tick, dragLastTick);
+  if (dt > 0) {
+    int32_t instantVelocity = ((int32_t)dy * 32768) / (int32_t)dt;
+    dragVelocity = (dragVelocity + instantVelocity) / 2;
+  }
+  dragLastX = x;
+  dragLastY = y;
+  dragLastTick = tick;
+  return dy;
+}
+
+/* 
+  Finger has been lifted, work out whether the touch was a tap, a swipe or a fling (or just the end of a slow drag)
+ */
+uint8_t dragTouchUp(uint8_t x, uint8_t y, uint32_t tick) {
+  if (!dragging)
+    return DRAG_RELEASE_TAP;
+  dragging = false;
+  int16_t totalDx = (int16_t)x - dragStartX;
+  int16_t totalDy = (int16_t)y - dragStartY;
+  if (abs(totalDx) < DRAG_TAP_SLOP && abs(totalDy) < DRAG_TAP_SLOP)
+    return DRAG_RELEASE_TAP;
+  if (abs(totalDx) > abs(totalDy) && abs(totalDx) > DRAG_SWIPE_DISTANCE)
+    return totalDx < 0 ? DRAG_RELEASE_SWIPE_LEFT : DRAG_RELEASE_SWIPE_RIGHT;
+  //If the finger was held still before being lifted, the velocity is stale
+  if (RTC_TICKS_TO_MS(RTC_TICK_DIFF(tick, dragLastTick)) > DRAG_RELEASE_TIMEOUT_MS)
+    dragVelocity = 0;
+  if (abs(dragVelocity) < FLING_MIN_VELOCITY)
+    return DRAG_RELEASE_NONE;
+  kineticScrolling = true;
+  kineticVelocity = dragVelocity * 256;
+  kineticRemainder = 0;
+  kineticLastTick = tick;
+  return DRAG_RELEASE_FLING;
+}
+
+/* 
+  Check whether a finger is currently down
+ */
+bool isDragging() {
+  return dragging;
+}
+
+/* 
+  Get the estimated vertical velocity of the finger in pixels per second
+ */
+int32_t getDragVelocity() {
+  return dragVelocity;
+}
+
+/* 
+  Advance the fling to the given time, returning the number of pixels to scroll by
+  Velocity decays by dt / FLING_TIME_CONSTANT_MS each step (an exponential decay). The decay is worked out in RTC ticks
+  on the Q8 velocity, as whole milliseconds and whole pixels per second both round a 1ms step's decay down to nothing
+  Sub-pixel movement is kept in kineticRemainder so slow flings still move smoothly
+ */
+int16_t kineticScrollStep(uint32_t tick) {
+  if (!kineticScrolling)
+    return 0;
+  uint32_t dt = RTC_TICK_DIFF(tick, kineticLastTick);
+  kineticLastTick = tick;
+  if (RTC_TICKS_TO_MS(dt) > FLING_MAX_STEP_MS)
+    dt = MS_TO_RTC_TICKS(FLING_MAX_STEP_MS);
+  //Distance in 1/256ths of a pixel = velocity (Q8) * dt (ticks) / 32768
+  kineticRemainder += (int32_t)(((int64_t)kineticVelocity * dt) >> 15);
+  int16_t step = kineticRemainder / 256;
+  kineticRemainder -= step * 256;
+  kineticVelocity -= (int32_t)(((int64_t)kineticVelocity * dt) / MS_TO_RTC_TICKS(FLING_TIME_CONSTANT_MS));
+  if (abs(kineticVelocity) < FLING_STOP_VELOCITY * 256)
+    stopKineticScroll();
+  return step;
+}
+
+/* 
+  Check whether a fling is in progress
+ */
+bool isKineticScrolling() {
+  return kineticScrolling;
+}
+
+/* 
+  Stop a fling (eg when the list reaches its end)
+ */
+void stopKineticScroll() {
+  kineticScrolling = false;
+  kineticVelocity = 0;
+}
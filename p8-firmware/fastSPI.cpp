@@ -25,6 +25,10 @@
   } NRF_SPIM_Type;
 */
 
+volatile bool spiAsyncBusy = false;
+volatile uint32_t spiAsyncPtr = 0;        //Start of the next chunk of an asynchronous write
+volatile uint32_t spiAsyncRemaining = 0;  //Bytes left to write after the current chunk
+
 /*
   Initialize fast SPI interface for display/flash for use with EasyDMA
 */
@@ -46,6 +50,11 @@ void initFastSPI() {
   NRF_SPIM2->INTENSET = 0;            //SPI interrupt disable
   NRF_SPIM2->ORC = 255;               //Over-read character
   NRF_SPIM2->CONFIG = 0;              //Configuration register
+
+  NVIC_DisableIRQ(SPIM2_SPIS2_SPI2_IRQn);
+  NVIC_ClearPendingIRQ(SPIM2_SPIS2_SPI2_IRQn);
+  NVIC_SetPriority(SPIM2_SPIS2_SPI2_IRQn, SPI_IRQ_PRIORITY);
+  NVIC_EnableIRQ(SPIM2_SPIS2_SPI2_IRQn);
 }
 
 /*
@@ -57,6 +66,7 @@ void enableSPI(bool state) {
   } else {
     while (NRF_SPIM2->ENABLE == 0) NRF_SPIM2->ENABLE = 0;
   }
+  setPowerState(POWER_CONSUMER_SPI, state ? POWER_STATE_ACTIVE : POWER_STATE_IDLE);
 }
 
 /*
@@ -85,6 +95,7 @@ void disableSingleByteWorkaround(NRF_SPIM_Type *spim, uint32_t ppi_channel, uint
   Write a byte buffer over SPI
 */
 void writeSPI(uint8_t *ptr, uint32_t len) {
+  waitForSPI();  //Let an asynchronous write finish first
   //Handle edge case workaround
   if (len == 1)
     enableSingleByteWorkaround(NRF_SPIM2, 8, 8);
@@ -127,6 +138,76 @@ void writeSPI(uint8_t *ptr, uint32_t len) {
   } while (len);
 }
 
+/*
+  Start the next chunk (at most 255 bytes) of an asynchronous write
+*/
+static void startAsyncChunk() {
+  uint32_t chunk = spiAsyncRemaining > 0xFF ? 0xFF : spiAsyncRemaining;
+  NRF_SPIM2->TXD.PTR = spiAsyncPtr;
+  NRF_SPIM2->TXD.MAXCNT = chunk;
+  NRF_SPIM2->RXD.PTR = 0;
+  NRF_SPIM2->RXD.MAXCNT = 0;
+  spiAsyncPtr += chunk;
+  spiAsyncRemaining -= chunk;
+  NRF_SPIM2->TASKS_START = 1;
+}
+
+/*
+  Write a byte buffer over SPI without waiting for it to finish
+  The END interrupt starts each 255 byte chunk after the last, so the CPU is free (or asleep) during the write
+  The buffer must stay valid and unchanged, and chip select must stay low, until isSPIBusy() returns false
+  (postWrite() and writeSPI() wait for this)
+*/
+void writeSPIAsync(uint8_t *ptr, uint32_t len) {
+  waitForSPI();
+  if (len == 0)
+    return;
+  if (len == 1)
+    enableSingleByteWorkaround(NRF_SPIM2, 8, 8);
+  else
+    disableSingleByteWorkaround(NRF_SPIM2, 8, 8);
+  spiAsyncBusy = true;
+  spiAsyncPtr = (uint32_t)ptr;
+  spiAsyncRemaining = len;
+  NRF_SPIM2->EVENTS_END = 0;
+  NRF_SPIM2->INTENSET = SPIM_INTENSET_END_Msk;
+  startAsyncChunk();
+}
+
+/*
+  Check whether an asynchronous write is still in progress
+*/
+bool isSPIBusy() {
+  return spiAsyncBusy;
+}
+
+/*
+  Wait for an asynchronous write to finish
+*/
+void waitForSPI() {
+  while (spiAsyncBusy)
+    ;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void SPIM2_SPIS2_SPI2_IRQHandler() {
+  if (NRF_SPIM2->EVENTS_END) {
+    NRF_SPIM2->EVENTS_END = 0;
+    if (spiAsyncRemaining > 0) {
+      startAsyncChunk();
+    } else {
+      NRF_SPIM2->INTENCLR = SPIM_INTENCLR_END_Msk;
+      spiAsyncBusy = false;
+    }
+  }
+  (void)NRF_SPIM2->EVENTS_END;
+}
+#ifdef __cplusplus
+}
+#endif
+
 /*
   Send data in command mode
 */
@@ -155,6 +236,7 @@ void preWrite() {
   Handle stopping SPI and deselecting display
 */
 void postWrite() {
+  waitForSPI();
   digitalWrite(LCD_CS, HIGH);  //Unselect
   enableSPI(false);
 }
@@ -0,0 +1,122 @@
+#include "headers/governor.h"
+
+#include "headers/powerControl.h"
+#include "headers/screenController.h"
+
+/*
+  Power governor
+  The backlight limit, sleep timeout, screen refresh rate and sensor duty are set by one of a few profiles,
+  which is picked from the charge state and battery percent (with some hysteresis, so the profile doesn't flip back
+  and forth as the battery voltage wobbles under load)
+  The knobs that already exist are set directly. Anything added later that uses power periodically (eg sensors) registers
+  a hook with addGovernorHook(), which is called with the new profile whenever it changes
+ */
+
+const PowerProfile powerProfiles[NUM_POWER_PROFILES] = {
+    {"Charging", MAX_BRIGHTNESS, 30, 0, 1},
+    {"Normal", MAX_BRIGHTNESS, DEFAULT_SLEEP_TIME, 0, 1},
+    {"Saver", 4, 7, 100, 2},
+    {"Critical", MIN_BRIGHTNESS, 5, 500, 4},
+};
+
+GovernorHook governorHooks[MAX_GOVERNOR_HOOKS];
+uint8_t numGovernorHooks = 0;
+uint8_t currentProfile = PROFILE_NORMAL;
+
+/* 
+  Apply the normal profile and start checking the battery
+ */
+void initGovernor() {
+  applyPowerProfile(PROFILE_NORMAL);
+  addTask(updateGovernor, GOVERNOR_PERIOD_MS, GOVERNOR_PERIOD_MS);
+}
+
+/* 
+  Pick the profile for the current battery and charge state
+ */
+static uint8_t choosePowerProfile() {
+  if (getChargeState())
+    return PROFILE_CHARGING;
+  uint16_t percent = getBatteryPercent();
+  //Stay in a low battery profile until the battery is clearly above its threshold
+  uint8_t hysteresis = (currentProfile == PROFILE_SAVER || currentProfile == PROFILE_CRITICAL) ? GOVERNOR_HYSTERESIS_PERCENT : 0;
+  if (percent < CRITICAL_BATTERY_PERCENT + (currentProfile == PROFILE_CRITICAL ? hysteresis : 0))
+    return PROFILE_CRITICAL;
+  if (percent < SAVER_BATTERY_PERCENT + hysteresis)
+    return PROFILE_SAVER;
+  return PROFILE_NORMAL;
+}
+
+/* 
+  Set every knob to the values of a profile and tell the hooks
+ */
+void applyPowerProfile(uint8_t profile) {
+  const PowerProfile* settings = &powerProfiles[profile];
+  currentProfile = profile;
+  setMaxBrightness(settings->maxBrightness);
+  setSleepTime(settings->sleepTimeS);
+  setMinScreenUpdateMS(settings->minScreenUpdateMS);
+  setBatteryUpdatePeriod(BATTERY_AVERAGE_PERIOD_MS * settings->sensorPeriodScale);
+  for (uint8_t i = 0; i < numGovernorHooks; i++)
+    governorHooks[i](settings);
+}
+
+/* 
+  Scheduler task (every GOVERNOR_PERIOD_MS whilst awake) that changes profile when the battery or charge state changes
+  (whilst asleep there is nothing to retune, and the task runs as soon as the watch wakes)
+ */
+void updateGovernor() {
+  uint8_t profile = choosePowerProfile();
+  if (profile != currentProfile)
+    applyPowerProfile(profile);
+}
+
+/* 
+  Register a function to be called whenever the profile changes, returning false if there is no room
+  The hook is called straight away with the current profile
+ */
+bool addGovernorHook(GovernorHook hook) {
+  if (numGovernorHooks >= MAX_GOVERNOR_HOOKS)
+    return false;
+  governorHooks[numGovernorHooks++] = hook;
+  hook(&powerProfiles[currentProfile]);
+  return true;
+}
+
+/* 
+  Get the current profile (see PROFILE_ definitions)
+ */
+uint8_t getPowerProfile() {
+  return currentProfile;
+}
+
+/* 
+  Get the knob values of a profile
+ */
+const PowerProfile* getPowerProfileSettings(uint8_t profile) {
+  return &powerProfiles[profile < NUM_POWER_PROFILES ? profile : PROFILE_NORMAL];
+}
+
+/* 
+  Estimate the hours the remaining battery would last in a profile, from the power model's averages so far
+  The time spent awake is roughly proportional to the sleep timeout, so every consumer is scaled by the ratio of the
+  profile's sleep timeout to the current one (the current whilst asleep is tiny in comparison), and the backlight is also
+  scaled by the level the profile allows over the level in use. It is rough, but shows the difference between profiles in real usage
+ */
+uint32_t getProfileBatteryLifeHours(uint8_t profile) {
+  const PowerProfile* settings = getPowerProfileSettings(profile);
+  const PowerProfile* current = &powerProfiles[currentProfile];
+  uint32_t awakeUA = 0;
+  for (uint8_t i = 0; i < NUM_POWER_CONSUMERS; i++) {
+    uint32_t consumerUA = getAverageCurrentUA(i);
+    if (i == POWER_CONSUMER_BACKLIGHT && getBrightness() > 0) {
+      uint8_t level = getBrightness() < settings->maxBrightness ? getBrightness() : settings->maxBrightness;
+      consumerUA = consumerUA * level / getBrightness();
+    }
+    awakeUA += consumerUA;
+  }
+  uint32_t estimatedUA = awakeUA * settings->sleepTimeS / current->sleepTimeS;
+  if (estimatedUA == 0)
+    return 0;
+  return (uint32_t)BATTERY_CAPACITY_MAH * 1000 * getBatteryPercent() / 100 / estimatedUA;
+}
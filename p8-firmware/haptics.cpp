@@ -0,0 +1,176 @@
+#include "headers/haptics.h"
+
+/*
+  Vibration motor and status LED pattern engine on PWM1
+  A pattern is a table of steps (motor and LED intensity for a duration), which is expanded into a sequence of PWM values
+  (one per HAPTIC_STEP_MS) for EasyDMA to play. Sequence 0 is the pattern and sequence 1 is a single "both off" value
+  held for the gap, and the PWM's LOOP counter plays the pair once per repeat, so a whole alarm runs without the CPU
+  The decoder is in individual mode, channel 0 is the motor and channel 1 is the LED
+  The only interrupt is when the PWM stops (at the end of a pattern, or because a higher priority pattern asked it to),
+  which starts the next queued pattern or disables the PWM if there isn't one
+ */
+
+const PatternStep tapSteps[] = {{100, 0, 20}};
+const PatternStep ledPingSteps[] = {{0, 100, 10}};
+const PatternStep notificationSteps[] = {{80, 100, 100}, {0, 100, 80}, {80, 100, 100}};
+const PatternStep alarmSteps[] = {{100, 100, 150}, {0, 0, 100}, {100, 100, 150}, {0, 0, 100}, {100, 100, 150}};
+
+const Pattern patterns[NUM_PATTERNS] = {
+    {tapSteps, 1, 0, 1, HAPTIC_PRIORITY_FEEDBACK},
+    {ledPingSteps, 1, 0, 1, HAPTIC_PRIORITY_FEEDBACK},
+    {notificationSteps, 3, 0, 1, HAPTIC_PRIORITY_NOTIFICATION},
+    {alarmSteps, 5, 750, 7, HAPTIC_PRIORITY_ALARM}};
+
+uint16_t patternValues[HAPTIC_MAX_VALUES][4];                     //Only written whilst the PWM is stopped
+uint16_t gapValues[4] = {0, HAPTIC_LED_POLARITY | 0, 0, 0};        //Motor and LED off (not const, PWM EasyDMA can only read RAM)
+uint8_t hapticQueue[HAPTIC_QUEUE_SIZE];                            //In priority order
+uint8_t hapticQueueLength = 0;
+volatile uint8_t playingPattern = NO_PATTERN;
+
+/*
+  Set up PWM1 on the motor and LED pins (the pins must already be outputs in their off state)
+ */
+void initHaptics() {
+  NRF_PWM1->ENABLE = PWM_ENABLE_ENABLE_Disabled << PWM_ENABLE_ENABLE_Pos;
+  NRF_PWM1->PSEL.OUT[0] = VIBRATOR_OUT;
+  NRF_PWM1->PSEL.OUT[1] = GREEN_LEDS;
+  NRF_PWM1->PSEL.OUT[2] = PWM_PSEL_OUT_CONNECT_Disconnected << PWM_PSEL_OUT_CONNECT_Pos;
+  NRF_PWM1->PSEL.OUT[3] = PWM_PSEL_OUT_CONNECT_Disconnected << PWM_PSEL_OUT_CONNECT_Pos;
+  NRF_PWM1->MODE = PWM_MODE_UPDOWN_Up << PWM_MODE_UPDOWN_Pos;
+  NRF_PWM1->PRESCALER = PWM_PRESCALER_PRESCALER_DIV_16 << PWM_PRESCALER_PRESCALER_Pos;  //1MHz
+  NRF_PWM1->COUNTERTOP = HAPTIC_PWM_TOP;
+  NRF_PWM1->DECODER = (PWM_DECODER_LOAD_Individual << PWM_DECODER_LOAD_Pos) | (PWM_DECODER_MODE_RefreshCount << PWM_DECODER_MODE_Pos);
+  NRF_PWM1->SEQ[0].REFRESH = HAPTIC_STEP_MS * 1000 / HAPTIC_PWM_PERIOD_US - 1;
+  NRF_PWM1->SEQ[0].ENDDELAY = 0;
+  NRF_PWM1->SEQ[1].PTR = (uint32_t)gapValues;
+  NRF_PWM1->SEQ[1].CNT = 4;
+  NRF_PWM1->SEQ[1].ENDDELAY = 0;
+  NRF_PWM1->SHORTS = PWM_SHORTS_LOOPSDONE_STOP_Msk;
+  NRF_PWM1->INTENCLR = 0xFFFFFFFF;
+  NRF_PWM1->INTENSET = PWM_INTENSET_STOPPED_Msk;
+
+  NVIC_DisableIRQ(PWM1_IRQn);
+  NVIC_ClearPendingIRQ(PWM1_IRQn);
+  NVIC_SetPriority(PWM1_IRQn, HAPTIC_IRQ_PRIORITY);
+  NVIC_EnableIRQ(PWM1_IRQn);
+}
+
+/*
+  Expand a pattern into the value buffer and start the PWM (only call when the PWM is stopped)
+ */
+static void startPattern(uint8_t patternID) {
+  const Pattern* pattern = &patterns[patternID];
+  uint16_t numValues = 0;
+  for (uint8_t i = 0; i < pattern->numSteps; i++) {
+    const PatternStep* step = &pattern->steps[i];
+    uint16_t motor = (uint32_t)step->motor * HAPTIC_PWM_TOP / 100;  //Polarity bit clear, so the motor pin is low (on) for the first <value> counts
+    uint16_t led = HAPTIC_LED_POLARITY | ((uint32_t)step->led * HAPTIC_PWM_TOP / 100);
+    uint16_t stepValues = (step->durationMS + HAPTIC_STEP_MS / 2) / HAPTIC_STEP_MS;
+    if (stepValues == 0)
+      stepValues = 1;
+    for (uint16_t j = 0; j < stepValues && numValues < HAPTIC_MAX_VALUES; j++) {
+      patternValues[numValues][0] = motor;
+      patternValues[numValues][1] = led;
+      patternValues[numValues][2] = 0;
+      patternValues[numValues][3] = 0;
+      numValues++;
+    }
+  }
+  uint32_t gapPeriods = (uint32_t)pattern->gapMS * 1000 / HAPTIC_PWM_PERIOD_US;
+
+  NRF_PWM1->SEQ[0].PTR = (uint32_t)patternValues;
+  NRF_PWM1->SEQ[0].CNT = numValues * 4;
+  NRF_PWM1->SEQ[1].REFRESH = gapPeriods > 0 ? gapPeriods - 1 : 0;  //The gap is always at least one period, so the pattern ends off
+  NRF_PWM1->LOOP = pattern->repeats;
+  NRF_PWM1->EVENTS_STOPPED = 0;
+  NRF_PWM1->ENABLE = PWM_ENABLE_ENABLE_Enabled << PWM_ENABLE_ENABLE_Pos;
+  NRF_PWM1->TASKS_SEQSTART[0] = 1;
+  playingPattern = patternID;
+}
+
+/*
+  Insert a pattern into the queue after any of the same or higher priority
+  If the queue is full the lowest priority pattern is dropped (which might be this one)
+ */
+static bool queuePattern(uint8_t patternID) {
+  uint8_t priority = patterns[patternID].priority;
+  uint8_t index = 0;
+  while (index < hapticQueueLength && patterns[hapticQueue[index]].priority <= priority)
+    index++;
+  if (index >= HAPTIC_QUEUE_SIZE)
+    return false;
+  if (hapticQueueLength < HAPTIC_QUEUE_SIZE)
+    hapticQueueLength++;
+  for (uint8_t i = hapticQueueLength - 1; i > index; i--)
+    hapticQueue[i] = hapticQueue[i - 1];
+  hapticQueue[index] = patternID;
+  return true;
+}
+
+/*
+  Play a pattern (see PATTERN definitions)
+  If nothing is playing it starts straight away. A higher priority pattern than the one playing stops it (it isn't
+  resumed) and plays next, otherwise it is queued, except for feedback which is dropped if it can't play now
+  Returns false if the pattern was dropped
+ */
+bool playPattern(uint8_t patternID) {
+  if (patternID >= NUM_PATTERNS)
+    return false;
+  bool accepted = true;
+  uint8_t priority = patterns[patternID].priority;
+  NVIC_DisableIRQ(PWM1_IRQn);  //The interrupt handler also takes from the queue
+  if (playingPattern == NO_PATTERN) {
+    startPattern(patternID);
+  } else if (priority < patterns[playingPattern].priority) {
+    accepted = queuePattern(patternID);  //Goes to the front, and is started by the interrupt handler once stopped
+    NRF_PWM1->TASKS_STOP = 1;
+  } else if (priority == HAPTIC_PRIORITY_FEEDBACK) {
+    accepted = false;
+  } else {
+    accepted = queuePattern(patternID);
+  }
+  NVIC_EnableIRQ(PWM1_IRQn);
+  return accepted;
+}
+
+/*
+  Stop the pattern that is playing and empty the queue (the outputs are left off)
+ */
+void stopPatterns() {
+  NVIC_DisableIRQ(PWM1_IRQn);
+  hapticQueueLength = 0;
+  if (playingPattern != NO_PATTERN)
+    NRF_PWM1->TASKS_STOP = 1;
+  NVIC_EnableIRQ(PWM1_IRQn);
+}
+
+/*
+  Get the pattern that is playing (or NO_PATTERN)
+ */
+uint8_t getPlayingPattern() {
+  return playingPattern;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void PWM1_IRQHandler() {
+  if (NRF_PWM1->EVENTS_STOPPED) {
+    NRF_PWM1->EVENTS_STOPPED = 0;
+    if (hapticQueueLength > 0) {
+      uint8_t patternID = hapticQueue[0];
+      hapticQueueLength--;
+      for (uint8_t i = 0; i < hapticQueueLength; i++)
+        hapticQueue[i] = hapticQueue[i + 1];
+      startPattern(patternID);
+    } else {
+      //Nothing left to play, so hand the pins back to GPIO (which holds them off) and stop the PWM clock
+      NRF_PWM1->ENABLE = PWM_ENABLE_ENABLE_Disabled << PWM_ENABLE_ENABLE_Pos;
+      playingPattern = NO_PATTERN;
+    }
+  }
+  (void)NRF_PWM1->EVENTS_STOPPED;
+}
+#ifdef __cplusplus
+}
+#endif
@@ -1,10 +1,20 @@
 #pragma once
 #include "Arduino.h"
 #include "WatchScreenBase.h"
+#include "accelerometer.h"
+#include "activity.h"
+#include "boot.h"
+#include "deepSleep.h"
 #include "display.h"
+#include "drag.h"
+#include "governor.h"
+#include "hitRegions.h"
+#include "i2c.h"
 #include "p8Time.h"
 #include "pinout.h"
 #include "powerControl.h"
+#include "powerModel.h"
+#include "touch.h"
 #include "utils.h"
 
 #define KM_PER_STEP 0.00079f  //65cm per step
@@ -23,6 +33,12 @@ typedef struct {
   swipe left event" and instead the controller will move to the next drawer of apps
 */
 
+/* 
+  Taps on buttons are handled by registering hit regions in screenSetup() (see hitRegions.h)
+  The controller will then call screenRegionTap() with the regionID of the button that was tapped,
+  and screenTap() is only called for taps that don't land in any region
+*/
+
 /* 
   Main screen of the watch, shows time and other info
  */
@@ -61,8 +77,14 @@ class TimeScreen : public WatchScreenBase {
       drawChar({20, 142}, 3, GLYPH_BATTERY, COLOUR_WHITE, COLOUR_BLACK);
     }
     drawIntWithoutPrecedingZeroes({40, 145}, 3, getBatteryPercent());
+    drawString({20, 180}, 2, (char*)getActivityName(getActivity()));
   }
   void screenTap(uint8_t x, uint8_t y) {}
+  bool screenRepaintRegion(coord pos, uint8_t w, uint8_t h) {
+    if (rectsOverlap(pos, w, h, {80, 145}, FONT_WIDTH * 3, FONT_HEIGHT * 3))
+      drawChar({80, 145}, 3, '%', COLOUR_WHITE, COLOUR_BLACK);
+    return true;
+  }
   bool doesImplementSwipeRight() { return false; }
   bool doesImplementSwipeLeft() { return false; }
   uint8_t getScreenUpdateTimeMS() { return 20; }  //20ms update time
@@ -73,17 +95,22 @@ class TimeScreen : public WatchScreenBase {
  */
 class StopWatchScreen : public WatchScreenBase {
  private:
+  enum stopWatchButtons {
+    START_BUTTON,
+    STOP_BUTTON
+  };
   bool hasStarted = false;
   long startTime = 0;
-  char timeBuf[9];
+  char timeBuf[9] = {0};
 
  public:
   void screenSetup() {
     clearDisplay(true);
-    drawUnfilledRect({0, 0}, 110, 60, 7, COLOUR_GREEN);
-    drawUnfilledRect({130, 0}, 110, 60, 7, COLOUR_RED);
-    drawString({55 - STR_WIDTH("Start", 3) / 2, 18}, 3, "Start");  //Look at screenTap() for more info
-    drawString({185 - STR_WIDTH("Stop", 3) / 2, 18}, 3, "Stop");
+    drawStartButton();
+    drawStopButton();
+    //The tap areas meet in the middle, as the screen's old tap test did, with the outlines round the drawn buttons
+    setHitRegionOutline(addHitRegion({0, 0}, 120, 60, START_BUTTON, NULL, 7, COLOUR_GREEN), {0, 0}, 110, 60);
+    setHitRegionOutline(addHitRegion({121, 0}, 119, 60, STOP_BUTTON, NULL, 7, COLOUR_RED), {130, 0}, 110, 60);
   }
   void screenLoop() {
     if (hasStarted) {
@@ -91,11 +118,28 @@ class StopWatchScreen : public WatchScreenBase {
       drawString({120 - STR_WIDTH("00:00:00", 4) / 2, 115}, 4, timeBuf);
     }
   }
-  void screenTap(uint8_t x, uint8_t y) {
-    //This is effectively a button touch listener, making sure the touch is in bounds of the button
-    if (x < 120 && y < 60) {
+  bool screenRepaintRegion(coord pos, uint8_t w, uint8_t h) {
+    if (rectsOverlap(pos, w, h, {0, 0}, 110, 60))
+      drawStartButton();
+    if (rectsOverlap(pos, w, h, {130, 0}, 110, 60))
+      drawStopButton();
+    if (!hasStarted && timeBuf[0] != 0)  //A stopped time isn't redrawn by the loop
+      drawString({120 - STR_WIDTH("00:00:00", 4) / 2, 115}, 4, timeBuf);
+    return true;
+  }
+  void drawStartButton() {
+    drawUnfilledRect({0, 0}, 110, 60, 7, COLOUR_GREEN);
+    drawString({55 - STR_WIDTH("Start", 3) / 2, 18}, 3, "Start");  //Look at screenRegionTap() for more info
+  }
+  void drawStopButton() {
+    drawUnfilledRect({130, 0}, 110, 60, 7, COLOUR_RED);
+    drawString({185 - STR_WIDTH("Stop", 3) / 2, 18}, 3, "Stop");
+  }
+  void screenRegionTap(uint8_t regionID) {
+    //The controller has already checked that the touch is in bounds of the button
+    if (regionID == START_BUTTON) {
       startStopWatch();
-    } else if (x > 120 && y < 60) {
+    } else if (regionID == STOP_BUTTON) {
       stopStopWatch();
     }
   }
@@ -124,6 +168,11 @@ class TimeDateSetScreen : public WatchScreenBase {
   int8_t setDay = 15;
 
  public:
+  enum settingsButtons {
+    DEC_BUTTON,
+    INC_BUTTON
+  };
+
   enum settingsWindow {
     BRIGHTNESS,
     SECOND,
@@ -173,8 +222,8 @@ class TimeDateSetScreen : public WatchScreenBase {
         break;
     }
   }
-  void screenTap(uint8_t x, uint8_t y) {
-    if (x <= 120) {
+  void screenRegionTap(uint8_t regionID) {
+    if (regionID == DEC_BUTTON) {
       switch (currentSettingsWindow) {
         case BRIGHTNESS:
           decBrightness();
@@ -204,7 +253,7 @@ class TimeDateSetScreen : public WatchScreenBase {
             setYear--;
           break;
       }
-    } else if (x > 120) {
+    } else if (regionID == INC_BUTTON) {
       switch (currentSettingsWindow) {
         case BRIGHTNESS:
           incBrightness();
@@ -297,34 +346,176 @@ class TimeDateSetScreen : public WatchScreenBase {
         break;
     }
   }
+  bool screenRepaintRegion(coord pos, uint8_t w, uint8_t h) {
+    if (rectsOverlap(pos, w, h, {0, 60}, 115, 130))
+      drawUnfilledRectWithChar({0, 60}, 115, 130, 8, COLOUR_RED, '-', 6);
+    if (rectsOverlap(pos, w, h, {120, 60}, 115, 130))
+      drawUnfilledRectWithChar({120, 60}, 115, 130, 8, COLOUR_GREEN, '+', 6);
+    return true;
+  }
   void drawRects() {
     drawUnfilledRectWithChar({0, 60}, 115, 130, 8, COLOUR_RED, '-', 6);
     drawUnfilledRectWithChar({120, 60}, 115, 130, 8, COLOUR_GREEN, '+', 6);
+    //Each half of the screen is a tap area (as the screen's old tap test was), with the outlines round the drawn buttons
+    setHitRegionOutline(addHitRegion({0, 0}, 121, 212, DEC_BUTTON, NULL, 8, COLOUR_RED), {0, 60}, 115, 130);
+    setHitRegionOutline(addHitRegion({121, 0}, 119, 212, INC_BUTTON, NULL, 8, COLOUR_GREEN), {120, 60}, 115, 130);
   }
 };
 
 /* 
   Device info screen, with uptime, compile time and other info
  */
+#define INFO_PAGE_MAIN 0
+#define INFO_PAGE_POWER 1
+#define INFO_PAGE_I2C 2
+#define NUM_INFO_PAGES 3
+
 class InfoScreen : public WatchScreenBase {
  private:
   char timeBuf[9];
+  uint8_t page = INFO_PAGE_MAIN;  //Tapping goes through the pages
+  uint8_t drawnProfile = NUM_POWER_PROFILES;  //Profile whose name is on the power page (so it is only redrawn when it changes)
 
  public:
   void screenSetup() {
     clearDisplay(true);
-    drawString({0, 0}, 1, "Firmware by:");
-    drawString({0, 10}, 2, "Alex Underwood");
-    drawString({0, 30}, 1, "Uptime:");
-    drawString({0, 80}, 1, "Compiled:");
-    drawString({0, 90}, 2, __DATE__);
-    drawString({0, 110}, 2, __TIME__);
+    drawLabels({0, 0}, 240, 213);
+  }
+  bool screenRepaintRegion(coord pos, uint8_t w, uint8_t h) {
+    drawLabels(pos, w, h);
+    return true;
+  }
+  void screenTap(uint8_t x, uint8_t y) {
+    page = (page + 1) % NUM_INFO_PAGES;
+    screenSetup();
+  }
+  /* 
+    Draw the labels that are inside the rectangle (all labels are at x = 0, so only their rows are checked)
+   */
+  void drawLabels(coord pos, uint8_t w, uint8_t h) {
+    if (page == INFO_PAGE_POWER) {
+      drawPowerLabels(pos, w, h);
+      return;
+    }
+    if (page == INFO_PAGE_I2C) {
+      drawI2CLabels(pos, w, h);
+      return;
+    }
+    if (rectsOverlap(pos, w, h, {0, 0}, 240, FONT_HEIGHT))
+      drawString({0, 0}, 1, "Firmware by:");
+    if (rectsOverlap(pos, w, h, {0, 10}, 240, FONT_HEIGHT * 2))
+      drawString({0, 10}, 2, "Alex Underwood");
+    if (rectsOverlap(pos, w, h, {0, 30}, 240, FONT_HEIGHT))
+      drawString({0, 30}, 1, "Uptime:");
+    if (rectsOverlap(pos, w, h, {120, 30}, 120, FONT_HEIGHT))
+      drawString({120, 30}, 1, "Boot to frame ms:");
+    if (rectsOverlap(pos, w, h, {0, 80}, 240, FONT_HEIGHT))
+      drawString({0, 80}, 1, "Compiled:");
+    if (rectsOverlap(pos, w, h, {0, 90}, 140, FONT_HEIGHT * 2))
+      drawString({0, 90}, 2, __DATE__);
+    if (rectsOverlap(pos, w, h, {140, 90}, 100, FONT_HEIGHT))
+      drawString({140, 90}, 1, "Activity max us:");
+    if (rectsOverlap(pos, w, h, {0, 110}, 120, FONT_HEIGHT * 2))
+      drawString({0, 110}, 2, __TIME__);
+    if (rectsOverlap(pos, w, h, {120, 110}, 120, FONT_HEIGHT))
+      drawString({120, 110}, 1, "Raise wake/false:");
+    if (rectsOverlap(pos, w, h, {0, 130}, 240, FONT_HEIGHT))
+      drawString({0, 130}, 1, "Touch latency us (last/max):");
+    if (rectsOverlap(pos, w, h, {0, 160}, 120, FONT_HEIGHT))
+      drawString({0, 160}, 1, "Wakeups per second:");
+    if (rectsOverlap(pos, w, h, {120, 160}, 120, FONT_HEIGHT))
+      drawString({120, 160}, 1, "Accl config us:");
+    if (rectsOverlap(pos, w, h, {0, 190}, 240, FONT_HEIGHT))
+      drawString({0, 190}, 1, "Wake latency us (last/max):");
+  }
+  /* 
+    Draw the labels of the power model page, one row per consumer then the total
+   */
+  void drawPowerLabels(coord pos, uint8_t w, uint8_t h) {
+    if (rectsOverlap(pos, w, h, {0, 0}, 240, FONT_HEIGHT))
+      drawString({0, 0}, 1, "Average current nA:");
+    for (uint8_t i = 0; i < NUM_POWER_CONSUMERS; i++) {
+      if (rectsOverlap(pos, w, h, {0, 15 + i * 18}, 120, FONT_HEIGHT * 2))
+        drawString({0, 15 + i * 18}, 2, (char*)getPowerConsumerName(i));
+    }
+    if (rectsOverlap(pos, w, h, {0, 15 + NUM_POWER_CONSUMERS * 18}, 120, FONT_HEIGHT * 2))
+      drawString({0, 15 + NUM_POWER_CONSUMERS * 18}, 2, "Total");
+    if (rectsOverlap(pos, w, h, {0, 140}, 240, FONT_HEIGHT))
+      drawString({0, 140}, 1, "Estimated battery life hours:");
+    if (rectsOverlap(pos, w, h, {0, 175}, 60, FONT_HEIGHT))
+      drawString({0, 175}, 1, "Profile:");
+    if (rectsOverlap(pos, w, h, {0, 190}, 240, FONT_HEIGHT))
+      drawString({0, 190}, 1, "Hours left normal/saver/critical:");
+    drawnProfile = NUM_POWER_PROFILES;  //The name is drawn by drawPowerValues()
+  }
+  void drawPowerValues() {
+    uint32_t totalNA = 0;
+    for (uint8_t i = 0; i < NUM_POWER_CONSUMERS; i++) {
+      uint32_t averageNA = getAverageCurrentNA(i);
+      totalNA += averageNA;
+      drawIntWithPrecedingZeroes({120, 15 + i * 18}, 2, averageNA);
+    }
+    drawIntWithPrecedingZeroes({120, 15 + NUM_POWER_CONSUMERS * 18}, 2, totalNA);
+    drawIntWithPrecedingZeroes({0, 150}, 2, getEstimatedBatteryLifeHours());
+    if (drawnProfile != getPowerProfile()) {
+      drawnProfile = getPowerProfile();
+      drawFilledRect({60, 175}, 180, FONT_HEIGHT, COLOUR_BLACK);
+      drawString({60, 175}, 1, (char*)getPowerProfileSettings(drawnProfile)->name);
+    }
+    drawIntWithPrecedingZeroes({0, 200}, 1, getProfileBatteryLifeHours(PROFILE_NORMAL));
+    drawIntWithPrecedingZeroes({80, 200}, 1, getProfileBatteryLifeHours(PROFILE_SAVER));
+    drawIntWithPrecedingZeroes({160, 200}, 1, getProfileBatteryLifeHours(PROFILE_CRITICAL));
+  }
+  /* 
+    Draw the column labels of the I2C page (each device has two rows, see drawI2CValues())
+   */
+  void drawI2CLabels(coord pos, uint8_t w, uint8_t h) {
+    if (rectsOverlap(pos, w, h, {0, 0}, 240, FONT_HEIGHT))
+      drawString({0, 0}, 1, "I2C     Transfers      Errors");
+    if (rectsOverlap(pos, w, h, {0, 10}, 240, FONT_HEIGHT))
+      drawString({0, 10}, 1, "device  Merged         Bus ms");
+  }
+  /* 
+    Draw the bus statistics of each device that has used the bus (see i2c.cpp)
+   */
+  void drawI2CValues() {
+    char addressText[5];
+    for (uint8_t i = 0; i < I2C_MAX_DEVICES; i++) {
+      I2CDeviceStats* stats = getI2CDeviceStatsAt(i);
+      if (stats == NULL)
+        break;
+      uint8_t y = 30 + i * 30;
+      sprintf(addressText, "0x%02X", stats->address);
+      drawString({0, y}, 1, addressText);
+      drawIntWithPrecedingZeroes({48, y}, 1, stats->transactions);
+      drawIntWithPrecedingZeroes({138, y}, 1, stats->errors);
+      drawIntWithPrecedingZeroes({48, y + 10}, 1, stats->batchedReads);
+      drawIntWithPrecedingZeroes({138, y + 10}, 1, RTC_TICKS_TO_MS(stats->busTicks));
+    }
   }
   void screenLoop() {
+    if (page == INFO_PAGE_POWER) {
+      drawPowerValues();
+      return;
+    }
+    if (page == INFO_PAGE_I2C) {
+      drawI2CValues();
+      return;
+    }
     drawIntWithPrecedingZeroes({0, 40}, 2, millis());
+    drawIntWithPrecedingZeroes({120, 40}, 2, getBootToFirstFrameMS());
     drawIntWithoutPrecedingZeroes({0, 60}, 2, millis() / 1000 / 60 / 60 / 24);
     getStopWatchTime(timeBuf, 0, millis() % 86400000);
     drawString({35, 60}, 2, timeBuf);
+    drawIntWithPrecedingZeroes({0, 140}, 2, getTouchLatencyUS());
+    drawIntWithPrecedingZeroes({120, 140}, 2, getTouchLatencyUS(true));
+    drawIntWithPrecedingZeroes({0, 170}, 2, getWakeupsPerSecond());
+    drawIntWithPrecedingZeroes({120, 170}, 2, getAccelConfigUploadUS());
+    drawIntWithPrecedingZeroes({140, 100}, 1, getActivityClassifyUS(true));
+    drawIntWithPrecedingZeroes({120, 120}, 1, getRaiseWakeCount());
+    drawIntWithPrecedingZeroes({180, 120}, 1, getRaiseWakeCount(true));
+    drawIntWithPrecedingZeroes({0, 200}, 1, getWakeLatencyUS());
+    drawIntWithPrecedingZeroes({120, 200}, 1, getWakeLatencyUS(true));
   }
   bool doesImplementSwipeLeft() { return false; }
   bool doesImplementSwipeRight() { return false; }
@@ -332,18 +523,49 @@ class InfoScreen : public WatchScreenBase {
 };
 
 /* 
-  Screen that allows rebooting and reboot to bootloader
+  Screen that allows rebooting, reboot to bootloader and switching off (System OFF, see deepSleep.cpp)
  */
 class PowerScreen : public WatchScreenBase {
+ private:
+  enum powerButtons {
+    REBOOT_BUTTON,
+    BOOTLOADER_BUTTON,
+    DEEP_SLEEP_BUTTON,
+    RAISE_WAKE_BUTTON
+  };
+
  public:
   void screenSetup() {
     clearDisplay(true);
-    drawUnfilledRectWithChar({0, 0}, 70, 70, 5, COLOUR_WHITE, GLYPH_REBOOT_UNSEL, 4);
-    drawUnfilledRectWithChar({85, 0}, 70, 70, 5, COLOUR_WHITE, GLYPH_BOOTLOADER_UNSEL, 4);
-    drawUnfilledRect({170, 0}, 70, 70, 5, COLOUR_WHITE);
+    drawButtons({0, 0}, 240, 70);
+    addHitRegion({0, 0}, 70, 70, REBOOT_BUTTON, NULL, 5, COLOUR_WHITE);
+    setHitRegionOutline(addHitRegion({71, 0}, 69, 70, BOOTLOADER_BUTTON, NULL, 5, COLOUR_WHITE), {85, 0}, 70, 70);  //The old tap area
+    addHitRegion({170, 0}, 70, 70, DEEP_SLEEP_BUTTON, NULL, 5, COLOUR_WHITE);
+    addHitRegion({0, 85}, 240, 60, RAISE_WAKE_BUTTON, NULL, 5, COLOUR_WHITE);
   }
-  void screenTap(uint8_t x, uint8_t y) {
-    if (y < 70 && x < 70) {
+  bool screenRepaintRegion(coord pos, uint8_t w, uint8_t h) {
+    drawButtons(pos, w, h);
+    return true;
+  }
+  /* 
+    Draw the buttons that are inside the rectangle
+   */
+  void drawButtons(coord pos, uint8_t w, uint8_t h) {
+    if (rectsOverlap(pos, w, h, {0, 0}, 70, 70))
+      drawUnfilledRectWithChar({0, 0}, 70, 70, 5, COLOUR_WHITE, GLYPH_REBOOT_UNSEL, 4);
+    if (rectsOverlap(pos, w, h, {85, 0}, 70, 70))
+      drawUnfilledRectWithChar({85, 0}, 70, 70, 5, COLOUR_WHITE, GLYPH_BOOTLOADER_UNSEL, 4);
+    if (rectsOverlap(pos, w, h, {170, 0}, 70, 70))
+      drawUnfilledRectWithChar({170, 0}, 70, 70, 5, COLOUR_WHITE, GLYPH_POWER_UNSEL, 4);
+    if (rectsOverlap(pos, w, h, {0, 85}, 240, 60))
+      drawRaiseWakeButton();
+  }
+  void drawRaiseWakeButton() {
+    drawUnfilledRect({0, 85}, 240, 60, 5, COLOUR_WHITE);
+    drawString({120 - STR_WIDTH("Raise wake off", 2) / 2, 107}, 2, getRaiseWake() ? "Raise wake on " : "Raise wake off");
+  }
+  void screenRegionTap(uint8_t regionID) {
+    if (regionID == REBOOT_BUTTON) {
       __DSB(); /* Ensure all outstanding memory accesses included
                   buffered write are completed before reset */
 
@@ -356,10 +578,15 @@ class PowerScreen : public WatchScreenBase {
       {
         __NOP();
       }
-    } else if (x > 70 && x < 140 && y < 70) {
+    } else if (regionID == BOOTLOADER_BUTTON) {
       //Enter the bootloader by setting the general purpose retention register to 1 and rebooting
       NRF_POWER->GPREGRET = 0x01;
       NVIC_SystemReset();
+    } else if (regionID == DEEP_SLEEP_BUTTON) {
+      enterDeepSleep();
+    } else if (regionID == RAISE_WAKE_BUTTON) {
+      setRaiseWake(!getRaiseWake());
+      drawRaiseWakeButton();
     }
   }
   bool doesImplementSwipeLeft() { return false; }
@@ -368,19 +595,95 @@ class PowerScreen : public WatchScreenBase {
 
 /* 
   Random screen for messing with and testing stuff 
+  Currently a scrolling list to test dragging, flinging and hardware scrolling
+  Content row y of the list is always drawn at display memory line (y - baseOffset) % LIST_VIEW_HEIGHT, so scrolling is
+  just moving the scroll start line and drawing the rows that have come into view. baseOffset only changes when the
+  list is redrawn unscrolled for an overlay (see screenResetScroll())
 */
+#define LIST_ITEM_HEIGHT 24
+#define LIST_NUM_ITEMS 30
+#define LIST_VIEW_HEIGHT 213  //Everything above the app drawer scrolls
+#define LIST_MAX_OFFSET (LIST_NUM_ITEMS * LIST_ITEM_HEIGHT - LIST_VIEW_HEIGHT)
+
 class DemoScreen : public WatchScreenBase {
  private:
-  uint8_t charX, charY;
-  char charToWrite = '~';
+  int16_t scrollOffset = 0;  //Content row at the top of the screen
+  int16_t baseOffset = 0;    //Content row drawn at memory line 0
+  char itemText[9];
 
  public:
   void screenSetup() {
     clearDisplay(true);
-    writeNewChar({0, 0}, charToWrite);
+    scrollOffset = 0;
+    baseOffset = 0;
+    setScrollArea(0, LIST_VIEW_HEIGHT);
+    setScrollStart(0);
+    drawListRows(0, LIST_VIEW_HEIGHT);
+  }
+  void screenDestroy() {
+    resetScroll();
+  }
+  void screenResetScroll() {
+    baseOffset = scrollOffset;
+    setScrollStart(0);
+    drawListRows(scrollOffset, scrollOffset + LIST_VIEW_HEIGHT);
+  }
+  bool screenRepaintRegion(coord pos, uint8_t w, uint8_t h) {
+    if (pos.y >= LIST_VIEW_HEIGHT)
+      return true;
+    uint8_t end = pos.y + h < LIST_VIEW_HEIGHT ? pos.y + h : LIST_VIEW_HEIGHT;
+    drawListRows(scrollOffset + pos.y, scrollOffset + end);  //Screen row r always shows content row scrollOffset + r
+    return true;
   }
   void screenLoop() {}
   bool doesImplementSwipeRight() { return false; }
   bool doesImplementSwipeLeft() { return false; }
+  bool doesImplementDrag() { return true; }
+  void screenDrag(int16_t dx, int16_t dy) {
+    int16_t newOffset = scrollOffset - dy;  //Moving the finger up moves further down the list
+    if (newOffset < 0)
+      newOffset = 0;
+    if (newOffset > LIST_MAX_OFFSET)
+      newOffset = LIST_MAX_OFFSET;
+    if (newOffset == scrollOffset) {  //At the end of the list, so stop any fling
+      stopKineticScroll();
+      return;
+    }
+    int16_t oldOffset = scrollOffset;
+    scrollOffset = newOffset;
+    setScrollStart(memoryLineOf(scrollOffset));
+    //Only draw the rows that have just come into view
+    if (newOffset > oldOffset)
+      drawListRows(oldOffset + LIST_VIEW_HEIGHT > newOffset ? oldOffset + LIST_VIEW_HEIGHT : newOffset, newOffset + LIST_VIEW_HEIGHT);
+    else
+      drawListRows(newOffset, oldOffset < newOffset + LIST_VIEW_HEIGHT ? oldOffset : newOffset + LIST_VIEW_HEIGHT);
+  }
+  /* 
+    Get the display memory line that content row y is drawn at (content above baseOffset wraps to the end)
+   */
+  uint8_t memoryLineOf(int16_t y) {
+    int16_t line = (y - baseOffset) % LIST_VIEW_HEIGHT;
+    return line < 0 ? line + LIST_VIEW_HEIGHT : line;
+  }
+  /* 
+    Draw content rows [start, end) of the list
+    Rows are drawn an item at a time, split where the memory lines wrap around
+   */
+  void drawListRows(int16_t start, int16_t end) {
+    int16_t y = start;
+    while (y < end) {
+      int16_t item = y / LIST_ITEM_HEIGHT;
+      uint8_t rowInItem = y - item * LIST_ITEM_HEIGHT;
+      uint8_t memoryLine = memoryLineOf(y);
+      int16_t rows = LIST_ITEM_HEIGHT - rowInItem;
+      if (rows > end - y)
+        rows = end - y;
+      if (memoryLine + rows > LIST_VIEW_HEIGHT)
+        rows = LIST_VIEW_HEIGHT - memoryLine;
+      sprintf(itemText, "Item %02d", item);
+      drawStringRows({8, 4}, 2, itemText, COLOUR_WHITE, (item % 2) ? COLOUR_DARK_GREY : COLOUR_BLACK, rowInItem, rows, memoryLine);
+      y += rows;
+    }
+  }
   uint8_t getScreenUpdateTimeMS() { return 1; }  //Fast update time
 };
\ No newline at end of file
@@ -22,6 +22,7 @@ class WatchScreenBase {
   virtual void screenDestroy() {}
   virtual void screenLoop() {}
   virtual void screenTap(uint8_t x, uint8_t y) {}
+  virtual void screenRegionTap(uint8_t regionID) {}
   virtual void screenLongTap(uint8_t x, uint8_t y) {}
   virtual void swipeLeft() {}
   virtual void swipeRight() {}
@@ -32,5 +33,24 @@ class WatchScreenBase {
   virtual bool doesImplementSwipeUp() { return true; }
   virtual bool doesImplementSwipeDown() { return true; }
   virtual bool doesImplementLongTap() { return false; }
+  /*
+    A screen that implements drag puts the touch controller into stream mode whilst it is the current screen,
+    and gets screenDrag() with the finger movement (and the kinetic scroll movement after a fling) instead of swipe up/down
+    Taps and horizontal swipes are still detected from the streamed touches and handled as normal
+  */
+  virtual bool doesImplementDrag() { return false; }
+  virtual void screenDrag(int16_t dx, int16_t dy) {}
   virtual uint8_t getScreenUpdateTimeMS() { return 20; }
+  /*
+    Redraw the static content (anything drawn in screenSetup()) that is inside the rectangle, which has already been cleared
+    Dynamic content is redrawn by the next screenLoop(). Returning false means the screen can't do this,
+    so the controller will call screenSetup() again instead
+  */
+  virtual bool screenRepaintRegion(coord pos, uint8_t w, uint8_t h) { return false; }
+  /*
+    Redraw the screen as it is now with the scroll start at 0, so that screen rows are memory lines again
+    Called before an overlay is drawn (the overlay is drawn at memory lines). If the screen is still scrolled
+    afterwards, the controller resets the scroll and sets the screen up again instead
+  */
+  virtual void screenResetScroll() {}
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include "Arduino.h"
+#include "bma423.h"
+#include "coroutine.h"
+#include "i2c.h"
+#include "pinout.h"
+#include "utils.h"
+#include "watchdog.h"
+
+#define ACCEL_ADDRESS BMA4_I2C_ADDR_PRIMARY
+#define ACCEL_WATERMARK_FRAMES 50                                        //Samples per interrupt (half a second at 100Hz)
+#define ACCEL_FRAME_LENGTH (1 + BMA4_FIFO_A_LENGTH)                      //Header mode, so each sample has a header byte
+#define ACCEL_SENSORTIME_FRAME_LENGTH (1 + BMA4_SENSOR_TIME_LENGTH)      //Added after the last sample when the FIFO is read empty
+#define ACCEL_FIFO_READ_SIZE 512                                         //The watermark, samples that arrive whilst reading, and the sensor time
+#define ACCEL_FIFO_MAX_READ (ACCEL_FRAME_LENGTH * (ACCEL_FIFO_READ_SIZE / ACCEL_FRAME_LENGTH))  //A fuller FIFO (up to 1KB) is read in several passes of whole frames
+#define ACCEL_FIFO_CHUNK_LENGTH (ACCEL_FRAME_LENGTH * (255 / ACCEL_FRAME_LENGTH))  //Whole frames that fit in one EasyDMA transfer
+#define ACCEL_CONFIG_CHUNK_LENGTH 254                                    //Longest even length that fits in one EasyDMA transfer after the register
+#define ACCEL_CONFIG_LOAD_MS 150                                         //Time the sensor takes to load the feature config
+#define ACCEL_MAX_FRAMES (ACCEL_FIFO_READ_SIZE / ACCEL_FRAME_LENGTH)
+#define ACCEL_RING_SIZE 128                                              //Must be a power of two
+#define ACCEL_SENSORTIME_PER_SAMPLE 256                                  //Sensor time ticks (39.0625us) between samples at 100Hz
+#define ACCEL_SENSORTIME_MASK 0xFFFFFF                                   //The sensor time is 24 bits (it wraps every 655 seconds)
+#define ACCEL_SINGLE_TAP_SENSITIVITY 2                                   //0 = most sensitive, 7 = least (a tap on the glass whilst awake)
+#define ACCEL_DOUBLE_TAP_SENSITIVITY 4                                   //Less sensitive, so knocks whilst moving about don't wake the watch
+#define ACCEL_TAP_INTS (BMA423_SINGLE_TAP_INT | BMA423_DOUBLE_TAP_INT)
+
+//Wrist raise tuning (see accelInterruptSequence()), readings are 1024 per g
+#define ACCEL_RAISE_WAKE_DEFAULT true
+#define ACCEL_RAISE_MOTION_THRESHOLD 205                                 //Any-motion slope threshold, 0.49mg per count (about 100mg)
+#define ACCEL_RAISE_MOTION_DURATION 5                                    //Any-motion must last this many 20ms periods
+#define ACCEL_RAISE_SETTLE_MS 250                                        //Wait after motion before checking it ended up face up
+#define ACCEL_RAISE_MIN_FACE_UP 600                                      //Min reading out of the display for face up (about 0.6g)
+#define ACCEL_RAISE_MAX_TILT 500                                         //Max x and y readings for face up (about 30 degrees of tilt)
+#define ACCEL_RAISE_Z_SIGN 1                                             //-1 if the sensor's z axis points into the display
+#define ACCEL_RAISE_CONFIRM_MS 3000                                      //Lowered again within this long after a raise wake = a false wake
+
+/*
+  One accelerometer sample
+  x, y, z = raw 12 bit readings (+-2g range, so 1024 per g)
+  sensorTime = the accelerometer's sensor time of the sample (see ACCEL_SENSORTIME definitions)
+ */
+typedef struct {
+  int16_t x, y, z;
+  uint32_t sensorTime;
+} AccelSample;
+
+CoTask* initAccel();
+uint8_t accelInitSequence(CoTask* co);
+uint32_t getAccelConfigUploadUS();
+bool isAccelReady();
+void setRaiseWake(bool enable);
+bool getRaiseWake();
+void accelInterrupt(uint32_t edgeTick);
+uint8_t accelInterruptSequence(CoTask* co);
+uint16_t readAccelSamples(uint32_t* readIndex, AccelSample* samples, uint16_t maxSamples);
+uint32_t getAccelSampleCount();
+uint32_t getAccelDrainCount();
+uint32_t getAccelTapWakeCount();
+void sleepAccel();
+int8_t accelI2CRead(uint8_t registerAddress, uint8_t* readBuf, uint32_t readBufLength, void* intf_ptr);
+int8_t accelI2CWrite(uint8_t registerAddress, const uint8_t* writeBuf, uint32_t writeBufLength, void* intf_ptr);
+void accelDelay(uint32_t period_us, void* intf_ptr);
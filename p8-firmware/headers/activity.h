@@ -0,0 +1,47 @@
+#pragma once
+#include "Arduino.h"
+#include "accelerometer.h"
+#include "nrf52.h"
+#include "utils.h"
+
+#define ACTIVITY_WINDOW_SAMPLES 128          //1.28 seconds at 100Hz, the whole accelerometer ring buffer (must be even)
+#define ACTIVITY_READ_BATCH 16               //Samples copied out of the ring buffer at a time
+#define ACTIVITY_COEFF_SHIFT 14              //Goertzel coefficients are Q14 (2cos can be up to 2)
+#define ACTIVITY_NUM_BINS 5                  //Goertzel bins 1 - 5 (0.78Hz each at 100Hz over 128 samples)
+#define ACTIVITY_ZC_HYSTERESIS 24            //Zero crossings must swing this far past the mean (about 25mg)
+#define ACTIVITY_CONFIRM_WINDOWS 2           //Windows in a row that must agree before the activity changes
+
+//Classifier thresholds, energies are sums of squared deviations over the window (1024 per g)
+#define ACTIVITY_IDLE_ENERGY 1300000         //Below this the window is idle (about 0.1g RMS)
+#define ACTIVITY_RUN_ENERGY 25000000         //Running needs at least this (about 0.43g RMS)
+#define ACTIVITY_MIN_PERIODIC_PERCENT 35     //Less than this percent of the energy in the step bands isn't walking or running
+#define ACTIVITY_CYCLING_MIN_CROSSINGS 12    //Non periodic movement with at least this many zero crossings is cycling
+
+#define ACTIVITY_IDLE 0
+#define ACTIVITY_WALK 1
+#define ACTIVITY_RUN 2
+#define ACTIVITY_CYCLING 3
+#define NUM_ACTIVITIES 4
+
+/*
+  The features of one window (see classifyWindow())
+  meanMagnitude = mean acceleration magnitude (1024 per g, about 1024 when still)
+  energy = sum of the squared deviations of the magnitude from the mean
+  zeroCrossings = number of times the magnitude crossed its mean
+  lowEnergy, walkEnergy, runEnergy = the part of energy in the 0.78Hz, 1.56 - 2.34Hz and 3.1 - 3.9Hz bins
+ */
+typedef struct {
+  uint16_t meanMagnitude;
+  uint32_t energy;
+  uint16_t zeroCrossings;
+  uint32_t lowEnergy;
+  uint32_t walkEnergy;
+  uint32_t runEnergy;
+} ActivityFeatures;
+
+void updateActivity();
+uint8_t classifyWindow(ActivityFeatures* features);
+uint8_t getActivity();
+const char* getActivityName(uint8_t activity);
+ActivityFeatures* getActivityFeatures();
+uint32_t getActivityClassifyUS(bool getMax = false);
@@ -0,0 +1,18 @@
+#pragma once
+#include "Arduino.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "pinout.h"
+#include "powerModel.h"
+#include "utils.h"
+
+#define BACKLIGHT_PWM_TOP 1000          //Duty resolution, at 2MHz this is a 2kHz PWM
+#define BACKLIGHT_PWM_PERIOD_US 500
+#define BACKLIGHT_LEVELS 7              //The old 3 bit levels, which setBrightness() still uses
+#define BACKLIGHT_LEVEL_TO_DUTY(level) ((uint16_t)((level) * BACKLIGHT_PWM_TOP / BACKLIGHT_LEVELS))
+#define BACKLIGHT_FADE_STEPS 32         //Max values in one fade sequence
+#define BACKLIGHT_IRQ_PRIORITY 3        //Only used to disable the PWM once the backlight has faded to off
+
+void initBacklight();
+void fadeBacklight(uint16_t duty, uint16_t fadeMS);
+uint16_t getBacklightDuty();
@@ -3,8 +3,14 @@
 
 #include "Arduino.h"
 #include "ioControl.h"
+#include "powerModel.h"
 #include "utils.h"
 
+//#define BLE_ENABLED  //Uncomment to start BLE at boot (eg to get the power model dump), it costs the advertising current
+
+#define BLE_COMMAND_POWER_MODEL 'P'
+#define BLE_NOTIFY_TIMEOUT_MS 500  //Longest wait for a free notification buffer before the rest of a dump is dropped
+
 void initBluetooth();
 void feedBle();
 void connectHandler(BLECentral& central);
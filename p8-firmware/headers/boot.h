@@ -0,0 +1,37 @@
+#pragma once
+#include "Arduino.h"
+#include "coroutine.h"
+#include "retained.h"
+#include "utils.h"
+
+//Boot stages, in the order they are started when their dependencies allow
+#define BOOT_STAGE_IO 0
+#define BOOT_STAGE_WATCHDOG 1
+#define BOOT_STAGE_SPI 2
+#define BOOT_STAGE_DISPLAY 3
+#define BOOT_STAGE_TWIM 4
+#define BOOT_STAGE_TOUCH 5
+#define BOOT_STAGE_INTERRUPTS 6
+#define BOOT_STAGE_SLEEP 7
+#define BOOT_STAGE_SCREEN 8
+#define BOOT_STAGE_ACCEL 9
+//NUM_BOOT_STAGES is in retained.h
+
+#define BOOT_STAGE_BIT(stage) (1 << (stage))
+
+/* 
+  A stage returns the coroutine that finishes it, or NULL if it finished straight away
+ */
+typedef CoTask* (*BootStageFunction)();
+
+/* 
+  function = starts the stage
+  dependencies = bitmap of the stages (BOOT_STAGE_BIT()) that must have finished before this stage starts
+ */
+typedef struct {
+  BootStageFunction function;
+  uint16_t dependencies;
+} BootStage;
+
+void runBootSequence();
+uint32_t getBootToFirstFrameMS();
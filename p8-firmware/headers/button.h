@@ -0,0 +1,20 @@
+#pragma once
+#include "Arduino.h"
+#include "pinout.h"
+#include "scheduler.h"
+#include "utils.h"
+
+#define BUTTON_DEBOUNCE_MS 20      //Edges this soon after an accepted edge are contact bounce
+#define BUTTON_LONG_PRESS_MS 600   //Held for this long = long press
+#define BUTTON_DOUBLE_PRESS_MS 300 //A press this soon after the last release = double press
+#define BUTTON_REPEAT_MS 200       //After a long press, a held event is sent this often until release
+
+//Button actions (see handleButtonAction())
+#define BUTTON_SHORT_PRESS 0  //Sent on release, straight away (so a double press is preceded by a short press)
+#define BUTTON_DOUBLE_PRESS 1 //Sent on the release of the second press
+#define BUTTON_LONG_PRESS 2   //Sent whilst still held, once BUTTON_LONG_PRESS_MS has passed
+#define BUTTON_HELD 3         //Repeated every BUTTON_REPEAT_MS after a long press until release
+
+void initButton();
+void buttonEdge(uint8_t edge, uint32_t tick);
+bool isButtonDown();
@@ -6,4 +6,5 @@
 #define COLOUR_ORANGE   0b1111101111100000
 #define COLOUR_CYAN     0b0000011111111111
 #define COLOUR_MAGENTA  0b1111100000011111
+#define COLOUR_DARK_GREY 0b0010000100000100
 #define COLOUR_BLACK    0b0000000000000000
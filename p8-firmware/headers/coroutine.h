@@ -0,0 +1,99 @@
+#pragma once
+#include "Arduino.h"
+#include "fastSPI.h"
+#include "i2c.h"
+#include "scheduler.h"
+#include "utils.h"
+
+#define MAX_COROUTINES 6
+
+//Returned by a coroutine function
+#define CO_WAITING 0
+#define CO_DONE 1
+
+//State of the I2C transaction a coroutine is waiting on
+#define CO_I2C_IDLE 0
+#define CO_I2C_PENDING 1
+#define CO_I2C_DONE 2
+
+/* 
+  Stackless coroutines (in the style of protothreads), so multi-step sequences with waits in them can be written
+  as linear code without blocking the rest of the firmware, and without needing a stack per task
+  A coroutine function looks like this:
+    uint8_t exampleSequence(CoTask* co) {
+      CO_BEGIN(co);
+      digitalWrite(PIN, LOW);
+      CO_DELAY_MS(co, 5);
+      digitalWrite(PIN, HIGH);
+      CO_AWAIT_I2C_WRITE(co, ADDRESS, REG, &data, 1);
+      CO_END(co);
+    }
+  It is run again from the top on every pass of the main loop, and the switch in CO_BEGIN jumps back to where it was waiting
+  This means that local variables are NOT kept across a wait (use static or global variables), and switch statements
+  can't contain a wait. Only one wait per line is allowed, since the line number is used as the resume point
+ */
+#define CO_BEGIN(co) \
+  switch ((co)->resumeLine) { \
+    case 0:
+#define CO_END(co) \
+  } \
+  (co)->resumeLine = 0; \
+  return CO_DONE;
+//Wait until condition is true (it is checked every time the main loop runs, ie after every interrupt or task)
+#define CO_AWAIT(co, condition) \
+  do { \
+    (co)->resumeLine = __LINE__; \
+    case __LINE__: \
+      if (!(condition)) \
+        return CO_WAITING; \
+  } while (0)
+#define CO_YIELD(co) \
+  do { \
+    (co)->resumeLine = __LINE__; \
+    return CO_WAITING; \
+    case __LINE__:; \
+  } while (0)
+//Timer delay, the scheduler wakes the CPU at the end of it
+#define CO_DELAY_MS(co, ms) CO_AWAIT(co, coDelay(co, ms))
+//Wait for an asynchronous SPI write (see writeSPIAsync())
+#define CO_AWAIT_SPI(co) CO_AWAIT(co, !isSPIBusy())
+//Wait for a pin level (only wakes straight away for pins that have an interrupt, ie the button and touch interrupt)
+#define CO_AWAIT_PIN(co, pin, level) CO_AWAIT(co, digitalRead(pin) == (level))
+//Register write/read through the I2C scheduler, waiting for completion. The result is in (co)->i2cSuccess
+#define CO_AWAIT_I2C_WRITE(co, address, reg, data, length) CO_AWAIT(co, coI2CWriteRegisters(co, address, reg, data, length))
+#define CO_AWAIT_I2C_READ(co, address, reg, rxBuf, length) CO_AWAIT(co, coI2CReadRegisters(co, address, reg, rxBuf, length))
+//Raw transfer (eg a long write, with the register address as the first byte of txBuf)
+#define CO_AWAIT_I2C_TRANSFER(co, address, txBuf, txLength, rxBuf, rxLength) CO_AWAIT(co, coI2CTransfer(co, address, txBuf, txLength, rxBuf, rxLength))
+
+struct CoTask;
+typedef uint8_t (*CoFunction)(struct CoTask* co);
+
+/* 
+  State of one coroutine (must be static or global, since it outlives the call that starts it)
+  resumeLine = the line it is waiting at (0 = start)
+  wakeTick = RTC2 tick at which the current delay ends
+  i2cState, i2cSuccess = the transaction it is waiting on, and its result
+  staleI2CCompletions = transactions queued by an earlier (restarted or cancelled) run that haven't finished yet,
+  their completions are ignored so they can't be taken as the result of the current run's transaction
+ */
+typedef struct CoTask {
+  CoFunction function;
+  uint16_t resumeLine;
+  bool running;
+  bool delaying;
+  uint32_t wakeTick;
+  volatile uint8_t i2cState;
+  volatile bool i2cSuccess;
+  volatile uint8_t staleI2CCompletions;
+} CoTask;
+
+void initCoroutines();
+bool startCoroutine(CoTask* co, CoFunction function);
+bool isCoroutineRunning(CoTask* co);
+void cancelCoroutine(CoTask* co);
+void runCoroutines();
+void waitForCoroutine(CoTask* co);
+bool coDelay(CoTask* co, uint32_t ms);
+bool coI2CWriteRegisters(CoTask* co, uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length);
+bool coI2CReadRegisters(CoTask* co, uint8_t address, uint8_t reg, uint8_t* rxBuf, uint8_t length);
+bool coI2CTransfer(CoTask* co, uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength);
@@ -0,0 +1,27 @@
+#pragma once
+#include <TimeLib.h>
+#include <nrf_sdm.h>
+#include <nrf_soc.h>
+
+#include "Arduino.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "pinout.h"
+#include "retained.h"
+#include "scheduler.h"
+#include "utils.h"
+
+//#define DEEP_SLEEP_AUTO  //Uncomment to switch off automatically when left in a drawer (the clock and raise/tap wake are lost)
+
+#define DEEP_SLEEP_AFTER_MS (3UL * 24 * 60 * 60 * 1000)  //Asleep (and not charging) for 3 days = left in a drawer
+#define DEEP_SLEEP_MAX_BATTERY_PERCENT 10                //...and only once the battery is low enough to be worth saving
+#define DEEP_SLEEP_CHECK_MS 60000                        //How often the time asleep is checked (must be under 131 seconds, see MS_TO_RTC_TICKS())
+#define DEEP_SLEEP_WAIT_MS 5                             //How often switchOff() checks whether the touch controller is asleep yet
+
+void initDeepSleep();
+void deepSleepCheck();
+void checkFastRestore();
+bool isFastRestore();
+void restoreSnapshot();
+void enterDeepSleep();
+void switchOff();
@@ -1,19 +1,35 @@
 #pragma once
 #include "Arduino.h"
 #include "colours.h"
+#include "coroutine.h"
 #include "fastSPI.h"
 #include "font.h"
 #include "font16.h"
 #include "pinout.h"
+#include "ramRetention.h"
 #include "utils.h"
 
+#define DISPLAY_SLEEP_OUT_MS 5  //Time after sleep out before the display takes another command
+#define DISPLAY_FRAME_MS 17     //One refresh of the panel (at the 60Hz set in initDisplay())
+
 //Old C style function definitions
-void initDisplay();
-void wakeDisplay();
+CoTask* initDisplay();
+CoTask* restoreDisplay();
+bool isDisplayReady();
+uint8_t displayInitSequence(CoTask* co);
+uint8_t displayRestoreSequence(CoTask* co);
+void displaySleepOut();
+void displayOn();
 void sleepDisplay();
 void drawFilledRect(coord pos, uint32_t w, uint32_t h, uint16_t colour);
 void setDisplayWriteRegion(coord pos, uint32_t w, uint32_t h);
+bool rectsOverlap(coord aPos, uint32_t aW, uint32_t aH, coord bPos, uint32_t bW, uint32_t bH);
 void clearDisplay(bool leaveAppDrawer = false);
+void setScrollArea(uint16_t topFixedLines, uint16_t scrollLines);
+void setScrollStart(uint16_t line);
+uint16_t getScrollStart();
+void resetScroll();
+void drawStringRows(coord textPos, uint8_t pixelsPerPixel, char* string, uint16_t colourFG, uint16_t colourBG, uint8_t firstRow, uint8_t numRows, uint8_t memoryLine);
 void drawChar(coord pos, uint8_t pixelsPerPixel, char character, uint16_t colourFG, uint16_t colourBG);
 void drawCharPixelToBuffer(coord charPos, uint8_t pixelsPerPixel, bool pixelInCharHere, uint16_t colourFG, uint16_t colourBG);
 void drawString(coord pos, uint8_t pixelsPerPixel, char* string, uint16_t colourFG = COLOUR_WHITE, uint16_t colourBG = COLOUR_BLACK);
@@ -0,0 +1,26 @@
+#pragma once
+#include "Arduino.h"
+#include "utils.h"
+
+#define DRAG_TAP_SLOP 8                //A touch that moves less than this many pixels is a tap rather than a drag
+#define DRAG_SWIPE_DISTANCE 60         //A mostly horizontal drag longer than this is a swipe
+#define DRAG_RELEASE_TIMEOUT_MS 100    //If the finger stops for this long before lifting, there is no fling
+#define FLING_MIN_VELOCITY 150         //Minimum release speed (pixels per second) to start a fling
+#define FLING_STOP_VELOCITY 20         //A fling stops when it slows to this speed (pixels per second)
+#define FLING_TIME_CONSTANT_MS 325     //Time for a fling to lose ~63% of its speed
+#define FLING_MAX_STEP_MS 50           //Longest time step for one kinetic update (so a stall doesn't cause a jump)
+
+#define DRAG_RELEASE_NONE 0
+#define DRAG_RELEASE_TAP 1
+#define DRAG_RELEASE_SWIPE_LEFT 2
+#define DRAG_RELEASE_SWIPE_RIGHT 3
+#define DRAG_RELEASE_FLING 4
+
+void dragTouchDown(uint8_t x, uint8_t y, uint32_t tick);
+int16_t dragTouchMove(uint8_t x, uint8_t y, uint32_t tick, int16_t* dx);
+uint8_t dragTouchUp(uint8_t x, uint8_t y, uint32_t tick);
+bool isDragging();
+int32_t getDragVelocity();
+int16_t kineticScrollStep(uint32_t tick);
+bool isKineticScrolling();
+void stopKineticScroll();
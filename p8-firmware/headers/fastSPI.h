@@ -3,13 +3,19 @@
 #include "nrf52.h"
 #include "nrf52_bitfields.h"
 #include "pinout.h"
+#include "powerModel.h"
 #include "utils.h"
 
+#define SPI_IRQ_PRIORITY 3  //Only chains the chunks of an asynchronous write
+
 void initFastSPI();
 void enableSPI(bool state);
 void enableSingleByteWorkaround(NRF_SPIM_Type *spim, uint32_t ppi_channel, uint32_t gpiote_channel);
 void disableSingleByteWorkaround(NRF_SPIM_Type *spim, uint32_t ppi_channel, uint32_t gpiote_channel);
 void writeSPI(uint8_t *ptr, uint32_t len);
+void writeSPIAsync(uint8_t *ptr, uint32_t len);
+bool isSPIBusy();
+void waitForSPI();
 void writeSPISingleByte(uint8_t d);
 void sendSPICommand(uint8_t command);
 void preWrite();
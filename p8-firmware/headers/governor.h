@@ -0,0 +1,44 @@
+#pragma once
+#include "Arduino.h"
+#include "ioControl.h"
+#include "powerModel.h"
+#include "scheduler.h"
+#include "utils.h"
+
+#define GOVERNOR_PERIOD_MS 6000       //How often the battery and charge state are checked
+#define MAX_GOVERNOR_HOOKS 4
+#define SAVER_BATTERY_PERCENT 30      //Below this the saver profile is used
+#define CRITICAL_BATTERY_PERCENT 10   //Below this the critical profile is used
+#define GOVERNOR_HYSTERESIS_PERCENT 5 //The battery must be this much above a threshold to leave its profile
+
+//Profiles, in order of how much power they save
+#define PROFILE_CHARGING 0
+#define PROFILE_NORMAL 1
+#define PROFILE_SAVER 2
+#define PROFILE_CRITICAL 3
+#define NUM_POWER_PROFILES 4
+
+/* 
+  The values of every power knob in one profile
+  maxBrightness = highest backlight level allowed (the user's level is kept if it is lower)
+  sleepTimeS = seconds after the last input before sleeping
+  minScreenUpdateMS = screens that want to refresh faster than this are slowed down to it
+  sensorPeriodScale = periodic sensor work (battery filtering, and sensors through hooks) is done this many times less often
+ */
+typedef struct {
+  const char* name;
+  uint8_t maxBrightness;
+  uint8_t sleepTimeS;
+  uint16_t minScreenUpdateMS;
+  uint8_t sensorPeriodScale;
+} PowerProfile;
+
+typedef void (*GovernorHook)(const PowerProfile* profile);
+
+void initGovernor();
+void updateGovernor();
+void applyPowerProfile(uint8_t profile);
+bool addGovernorHook(GovernorHook hook);
+uint8_t getPowerProfile();
+const PowerProfile* getPowerProfileSettings(uint8_t profile);
+uint32_t getProfileBatteryLifeHours(uint8_t profile);
@@ -0,0 +1,53 @@
+#pragma once
+#include "Arduino.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "pinout.h"
+#include "utils.h"
+
+#define HAPTIC_PWM_TOP 1000             //Duty resolution, at 1MHz this is a 1kHz PWM
+#define HAPTIC_PWM_PERIOD_US 1000
+#define HAPTIC_STEP_MS 10               //Each pattern value lasts this long (step durations are rounded to it)
+#define HAPTIC_MAX_VALUES 100           //Max number of HAPTIC_STEP_MS values in one repeat of a pattern (1 second)
+#define HAPTIC_QUEUE_SIZE 4             //Patterns waiting behind the one that is playing
+#define HAPTIC_IRQ_PRIORITY 3           //Only used to start the next pattern (or disable the PWM) when one stops
+#define HAPTIC_LED_POLARITY 0x8000      //The LED is active high, so its values have the polarity bit set (the motor is active low)
+
+//Lower number = higher priority, a higher priority pattern stops the one that is playing
+#define HAPTIC_PRIORITY_ALARM 0
+#define HAPTIC_PRIORITY_NOTIFICATION 1
+#define HAPTIC_PRIORITY_FEEDBACK 2      //Feedback is only useful straight away, so it is dropped rather than queued
+
+#define PATTERN_TAP 0                   //Short tick when a button is tapped
+#define PATTERN_LED_PING 1              //Quick flash of the LED (was ledPing())
+#define PATTERN_NOTIFICATION 2          //Two buzzes with the LED on
+#define PATTERN_ALARM 3                 //Three buzzes and LED flashes, repeated for about 10 seconds
+#define NUM_PATTERNS 4
+#define NO_PATTERN 0xFF
+
+/*
+  One step of a pattern
+  motor, led = intensity in percent (0 = off)
+  durationMS = how long the step lasts (rounded to HAPTIC_STEP_MS)
+ */
+typedef struct {
+  uint8_t motor;
+  uint8_t led;
+  uint16_t durationMS;
+} PatternStep;
+
+/*
+  A pattern is a list of steps, played repeats times with gapMS of both outputs off after each repeat
+ */
+typedef struct {
+  const PatternStep* steps;
+  uint8_t numSteps;
+  uint16_t gapMS;
+  uint8_t repeats;
+  uint8_t priority;
+} Pattern;
+
+void initHaptics();
+bool playPattern(uint8_t patternID);
+void stopPatterns();
+uint8_t getPlayingPattern();
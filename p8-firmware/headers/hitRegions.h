@@ -0,0 +1,48 @@
+#pragma once
+#include "Arduino.h"
+#include "colours.h"
+#include "display.h"
+#include "utils.h"
+
+#define MAX_HIT_REGIONS 24                                //Max number of tappable regions on one screen (including the app drawer)
+#define HIT_GRID_CELL_SIZE 8                              //Each grid cell covers 8*8 pixels
+#define HIT_GRID_SIZE (240 / HIT_GRID_CELL_SIZE)          //30*30 cells cover the whole display
+#define HIT_GRID_EMPTY 0xFF                               //No region touches this cell
+#define HIT_GRID_SHARED 0xFE                              //More than one region touches this cell, so the region list has to be checked
+#define NO_HIT_REGION 0xFF                                //Returned by findHitRegion() if nothing was hit
+#define HIT_REGION_PRESSED_COLOUR COLOUR_YELLOW           //Outline colour of a region just after it was tapped
+#define HIT_REGION_PRESSED_MS 120                         //A tapped region is drawn as pressed for at least this long
+
+/*
+  A handler is passed the regionID that was given when the region was registered
+  If a region has no handler (NULL), the tap is sent to currentScreen->screenRegionTap(regionID)
+ */
+typedef void (*HitRegionHandler)(uint8_t regionID);
+
+/*
+  A rectangle on the display that reacts to taps
+  pos, w, h = the bounds of the region
+  regionID = ID given to the handler so one handler can serve many regions (eg the keys of a keypad)
+  lineWidth = width of the outline that is redrawn as pressed feedback (0 means no feedback)
+  colour = colour of the outline when not pressed
+  outlinePos, outlineW, outlineH = the drawn button the outline goes round, which is the bounds unless the region is
+  bigger than the button (see setHitRegionOutline())
+ */
+typedef struct {
+  coord pos;
+  uint8_t w, h;
+  uint8_t regionID;
+  uint8_t lineWidth;
+  uint16_t colour;
+  HitRegionHandler handler;
+  coord outlinePos;
+  uint8_t outlineW, outlineH;
+} HitRegion;
+
+void clearHitRegions();
+uint8_t addHitRegion(coord pos, uint8_t w, uint8_t h, uint8_t regionID, HitRegionHandler handler = NULL, uint8_t lineWidth = 0, uint16_t colour = COLOUR_WHITE);
+void setHitRegionOutline(uint8_t index, coord pos, uint8_t w, uint8_t h);
+uint8_t findHitRegion(uint8_t x, uint8_t y);
+HitRegion* getHitRegion(uint8_t index);
+uint8_t getHitRegionGeneration();
+void drawHitRegionOutline(uint8_t index, bool pressed);
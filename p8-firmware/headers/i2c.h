@@ -0,0 +1,44 @@
+#pragma once
+#include "Arduino.h"
+#include "twim.h"
+#include "utils.h"
+
+#define I2C_QUEUE_SIZE 8        //Max number of transactions waiting for the bus
+#define I2C_MAX_WRITE_LENGTH 16 //Register writes up to this length are copied, so the caller's buffer can be on the stack
+#define I2C_BATCH_BUFFER_SIZE 32
+#define I2C_MAX_DEVICES 4       //Touch controller, accelerometer, heart rate sensor (and a spare)
+
+//Lower number = higher priority
+#define I2C_PRIORITY_TOUCH 0       //Touch input should never wait behind sensors
+#define I2C_PRIORITY_SENSOR 1      //Accelerometer and heart rate sensor data
+#define I2C_PRIORITY_BACKGROUND 2  //Setup, config uploads and anything else that isn't time critical
+
+/* 
+  Called when a transaction finishes (from the TWIM interrupt handler)
+  context is the pointer given when the transaction was submitted
+ */
+typedef void (*I2CCallback)(bool success, void* context);
+
+/* 
+  Bus usage for one device
+  busTicks = total RTC ticks that the bus spent on this device's transactions
+  maxTicks = longest single transaction
+ */
+typedef struct {
+  uint8_t address;
+  uint32_t transactions;
+  uint32_t errors;
+  uint32_t batchedReads;  //Reads that were merged into another read rather than using the bus themselves
+  uint32_t busTicks;
+  uint32_t maxTicks;
+} I2CDeviceStats;
+
+bool i2cTransfer(uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength, uint8_t priority, I2CCallback callback, void* context = NULL);
+bool i2cReadRegisters(uint8_t address, uint8_t reg, uint8_t* rxBuf, uint8_t length, uint8_t priority, I2CCallback callback, void* context = NULL);
+bool i2cWriteRegisters(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length, uint8_t priority, I2CCallback callback, void* context = NULL);
+bool i2cReadRegistersBlocking(uint8_t address, uint8_t reg, uint8_t* rxBuf, uint8_t length, uint8_t priority = I2C_PRIORITY_BACKGROUND);
+bool i2cWriteRegistersBlocking(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length, uint8_t priority = I2C_PRIORITY_BACKGROUND);
+bool i2cTransferBlocking(uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength, uint8_t priority = I2C_PRIORITY_BACKGROUND);
+bool i2cIsIdle();
+I2CDeviceStats* getI2CDeviceStats(uint8_t address);
+I2CDeviceStats* getI2CDeviceStatsAt(uint8_t index);
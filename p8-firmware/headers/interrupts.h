@@ -1,5 +1,8 @@
 #pragma once
 #include "Arduino.h"
+#include "accelerometer.h"
+#include "button.h"
+#include "governor.h"
 #include "ioControl.h"
 #include "nrf52.h"
 #include "nrf52_bitfields.h"
@@ -14,6 +17,60 @@
   Implemented in WInterrupts.h
  */
 
+#define EVENT_QUEUE_SIZE 32  //Must be a power of two (and at most 128)
+
+#define EVENT_SOURCE_TOUCH 0
+#define EVENT_SOURCE_BUTTON 1
+#define EVENT_SOURCE_CHARGER 2
+#define EVENT_SOURCE_ACCEL 3
+
+#define MAX_GPIO_EVENT_SOURCES 8
+
+#define EDGE_FALLING 0
+#define EDGE_RISING 1
+#define EDGE_MASK_FALLING (1 << EDGE_FALLING)
+#define EDGE_MASK_RISING (1 << EDGE_RISING)
+#define EDGE_MASK_BOTH (EDGE_MASK_FALLING | EDGE_MASK_RISING)
+
+/* 
+  Called from the GPIOTE interrupt handler with the edge and the RTC tick it was seen at
+ */
+typedef void (*GPIOEdgeHandler)(uint8_t edge, uint32_t tick);
+
+/* 
+  A pin that generates events
+  source = the EVENT_SOURCE of its events
+  edges = which edges are reported (see EDGE_MASK definitions)
+  handler = called from the interrupt handler instead of pushing an event (NULL to push events)
+ */
+typedef struct {
+  uint8_t pin;
+  uint8_t source;
+  uint8_t edges;
+  GPIOEdgeHandler handler;
+} GPIOEventSource;
+
+/* 
+  An event pushed by the GPIOTE interrupt handler
+  source = which pin changed (see EVENT_SOURCE definitions)
+  edge = the direction of the change
+  tick = RTC tick at which the interrupt handler saw the change (see RTC_TICKS())
+  touch = for touch events, the touch data that was read by the interrupt handlers
+ */
+typedef struct {
+  uint8_t source;
+  uint8_t edge;
+  uint32_t tick;
+  TouchDataStruct touch;
+} InterruptEvent;
+
 void initInterrupts();
+bool addGPIOEventSource(uint8_t pin, uint8_t source, uint8_t edges, GPIOEdgeHandler handler = NULL);
+void touchEdge(uint8_t edge, uint32_t tick);
+bool pushInterruptEvent(uint8_t source, uint8_t edge, uint32_t tick, TouchDataStruct* touch = NULL);
+bool popInterruptEvent(InterruptEvent* event);
+uint32_t getEventQueueOverflows();
 void handleInterrupts();
-void resetInterrupts();
\ No newline at end of file
+void handleTouchEvent(InterruptEvent* event);
+void handleChargerEvent(InterruptEvent* event);
+bool handleAccelTap(bool doubleTap, uint32_t tick);
@@ -1,10 +1,31 @@
 #pragma once
 #include "Arduino.h"
+#include "backlight.h"
+#include "haptics.h"
 #include "pinout.h"
+#include "powerModel.h"
+#include "saadc.h"
+#include "scheduler.h"
 #include "utils.h"
 #define MAX_BRIGHTNESS 7
 #define MIN_BRIGHTNESS 1
 #define BACKLIGHT_OFF 0
+#define BRIGHTNESS_CHANGE_FADE_MS 150  //Fade when the user changes the brightness
+#define BATTERY_AVERAGE_PERIOD_MS 6000  //How often the samples are filtered into the battery percent
+#define BATTERY_SAMPLE_PERIOD_MS (BATTERY_AVERAGE_PERIOD_MS / SAADC_RING_SIZE)  //SAADC sample period, so the ring covers one filter period (see saadc.cpp)
+#define BATTERY_FILTER_SHIFT 2          //IIR filter, each new median moves the voltage 1/4 of the way
+//Battery voltage divider, calibrated from the old analogRead() mapping (496 -> 3000mV, 696 -> 4200mV at 10 bits of VDD)
+#define BATTERY_DIVIDER_NUM 15
+#define BATTERY_DIVIDER_DEN 8
+#define NUM_BATTERY_CURVE_POINTS 12
+
+/* 
+  A point on the battery discharge curve
+ */
+typedef struct {
+  uint16_t milliVolts;
+  uint8_t percent;
+} BatteryCurvePoint;
 
 /* class IOController {
  private:
@@ -26,11 +47,15 @@ bool getButtonState();
 void ledOutput(bool on);
 void motorOutput(bool on);
 void setBrightness(int brightness);
+void fadeBrightness(int brightness, uint16_t fadeMS);
 int getBrightness();
+void setMaxBrightness(int brightness);
 void incBrightness();
 void decBrightness();
 void ledPing();
 uint16_t getBatteryPercent();
+uint16_t getBatteryMilliVolts();
 uint16_t milliVoltToPercent(int batteryMV);
-void addToCumulativeBatReading();
+void updateBatteryPercent();
+void setBatteryUpdatePeriod(uint32_t periodMS);
 bool getChargeState();
\ No newline at end of file
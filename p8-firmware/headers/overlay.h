@@ -0,0 +1,19 @@
+#pragma once
+#include "Arduino.h"
+#include "colours.h"
+#include "display.h"
+#include "font.h"
+#include "utils.h"
+
+#define OVERLAY_FONT_SIZE 2
+#define OVERLAY_PADDING 8             //Space between the text and the edge of the overlay
+#define OVERLAY_BORDER_WIDTH 2        //Width of the overlay outline
+#define OVERLAY_TOAST_Y 160           //Toasts are drawn just above the app drawer
+#define OVERLAY_TOAST_TIMEOUT_MS 2000 //Toasts disappear after 2 seconds
+#define OVERLAY_NO_TIMEOUT 0          //The overlay stays until it is tapped or dismissOverlay() is called
+
+void showOverlay(coord pos, uint8_t w, uint8_t h, const char* text, uint16_t colour, uint16_t timeoutMS);
+void showToast(const char* text, uint16_t colour = COLOUR_WHITE);
+void dismissOverlay();
+bool isOverlayVisible();
+void overlayLoop();
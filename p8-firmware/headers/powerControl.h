@@ -3,24 +3,41 @@
 #include <nrf_nvic.h>
 
 #include "Arduino.h"
+#include "coroutine.h"
 #include "display.h"
 #include "ioControl.h"
 #include "nrf52.h"
 #include "nrf52_bitfields.h"
 #include "nrf_soc.h"
+#include "scheduler.h"
 #include "touch.h"
 #include "utils.h"
+#include "watchdog.h"
 #define POWER_ON 1
 #define POWER_OFF 0
 #define DEFAULT_SLEEP_TIME 10
+#define SLEEP_DIM_MS 2000             //The backlight is dimmed this long before the sleep timeout (must be less than the shortest sleep time)
+#define SLEEP_DIM_DIVISOR 4           //Dimmed to a quarter of the brightness
+#define BACKLIGHT_DIM_FADE_MS 300
+#define BACKLIGHT_UNDIM_FADE_MS 100
+#define BACKLIGHT_WAKE_FADE_MS 120
 
 void initSleep();
 void enterSleep();
-void exitSleep();
+void exitSleep(uint32_t wakeTick = RTC_TICKS(), bool withTouch = true);
+void wakeTouch();
+void raiseWake(uint32_t wakeTick);
+bool isRaiseWakeUnconfirmed();
+void endRaiseWakeCheck(bool lowered);
+uint16_t getRaiseWakeCount(bool falseOnly = false);
+uint8_t wakeSequence(CoTask* co);
+uint32_t getWakeLatencyUS(bool getMax = false);
 bool getPowerMode();
 void sleepWait();
+void countWakeup();
 void setPowerMode(bool powerModeToSet);
 void updateLastWakeTime();
 void checkWakeTime();
 int getLastWakeTime();
-void setSleepTime(uint8_t seconds);
\ No newline at end of file
+void setSleepTime(uint8_t seconds);
+uint16_t getWakeupsPerSecond();
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include "Arduino.h"
+#include "scheduler.h"
+#include "utils.h"
+
+#define BATTERY_CAPACITY_MAH 170        //P8 battery capacity
+#define POWER_MODEL_UPDATE_MS 120000    //Integrate every consumer at least this often (RTC ticks wrap after 512 seconds)
+
+//Consumers, each of which is in one of up to MAX_POWER_STATES states
+#define POWER_CONSUMER_CPU 0
+#define POWER_CONSUMER_BACKLIGHT 1  //State is the brightness level (0 - 7)
+#define POWER_CONSUMER_DISPLAY 2
+#define POWER_CONSUMER_SPI 3
+#define POWER_CONSUMER_TOUCH 4
+#define POWER_CONSUMER_RAM 5        //State is the number of scratch RAM sections powered (see ramRetention.cpp)
+#define NUM_POWER_CONSUMERS 6
+#define MAX_POWER_STATES 8
+
+//States for the on/off consumers
+#define POWER_STATE_IDLE 0    //CPU in WFE, display/touch asleep, SPI disabled
+#define POWER_STATE_ACTIVE 1  //CPU running, display/touch awake, SPI enabled
+
+/* 
+  Time in each state and the charge used by one consumer
+  chargeNATicks = sum of (current in nA * RTC ticks) over every state the consumer has been in
+ */
+typedef struct {
+  uint8_t state;
+  uint32_t lastTick;
+  uint64_t chargeNATicks;
+} PowerConsumer;
+
+void initPowerModel();
+void setPowerState(uint8_t consumer, uint8_t state);
+void setPowerCurrentNA(uint8_t consumer, uint8_t state, uint32_t currentNA);
+void updatePowerModel();
+uint32_t getAverageCurrentNA(uint8_t consumer);
+uint32_t getAverageCurrentUA(uint8_t consumer);
+uint32_t getTotalAverageCurrentUA();
+uint32_t getEstimatedBatteryLifeHours();
+const char* getPowerConsumerName(uint8_t consumer);
+void dumpPowerModel(Print& out);
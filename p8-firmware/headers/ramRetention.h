@@ -0,0 +1,16 @@
+#pragma once
+#include "Arduino.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "powerModel.h"
+#include "utils.h"
+
+#define RAM_START 0x20000000
+#define RAM_SECTION_SIZE 4096   //RAM[n] blocks each have two 4KB sections (S0 and S1) that can be powered separately
+#define NUM_RAM_SECTIONS 16     //64KB
+
+void addScratchRAM(void* start, uint32_t length);
+void powerDownScratchRAM();
+void powerUpScratchRAM();
+uint8_t getScratchRAMSections();
+void retainRAMInSystemOff(void* start, uint32_t length);
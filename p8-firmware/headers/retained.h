@@ -0,0 +1,59 @@
+#pragma once
+#include "Arduino.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "utils.h"
+
+#define RETAINED_MAGIC 0x50385232  //"P8R2", marks the retained data as valid (RAM is random after power on), change it whenever RetainedData changes
+#define NUM_BOOT_STAGES 10
+#define SNAPSHOT_MAGIC 0x534E4150  //"SNAP", the snapshot was saved before System OFF and hasn't been restored yet
+
+/* 
+  Start and end RTC ticks of every boot stage (see boot.h), and the tick at which the first screen was drawn
+  RTC1 is reset with the rest of the chip, so these are ticks since boot
+ */
+typedef struct {
+  uint32_t stageStartTick[NUM_BOOT_STAGES];
+  uint32_t stageEndTick[NUM_BOOT_STAGES];
+  uint32_t firstFrameTick;
+} BootTimeline;
+
+/* 
+  State saved before entering System OFF (see deepSleep.cpp), and restored by the boot after the button wakes the watch
+  valid = SNAPSHOT_MAGIC if the snapshot is waiting to be restored
+  time = Unix time (TimeLib) when the watch was switched off
+  brightness = the user's backlight level
+  screenIndex = the home screen that was showing
+ */
+typedef struct {
+  uint32_t valid;
+  uint32_t time;
+  uint8_t brightness;
+  uint8_t screenIndex;
+} DeepSleepSnapshot;
+
+/* 
+  Data kept in RAM across a reset (but not a power cycle), for working out what happened before it
+  bootCount = boots since the retained data was last valid
+  resetReason = NRF_POWER->RESETREAS at this boot
+  lastBoot = the boot timeline of the boot before this one
+  watchdogAlive = bitmap of the watchdog channels that have checked in since the watchdog last reloaded (see watchdog.h)
+  lastWatchdogAlive = watchdogAlive as it was when the last boot ended (ie which subsystems were alive just before the reset)
+  watchdogStarved = bitmap of the channels that hadn't checked in when the watchdog last timed out
+  snapshot = state to restore after System OFF
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t bootCount;
+  uint32_t resetReason;
+  BootTimeline boot;
+  BootTimeline lastBoot;
+  uint8_t watchdogAlive;
+  uint8_t lastWatchdogAlive;
+  uint8_t watchdogStarved;
+  DeepSleepSnapshot snapshot;
+} RetainedData;
+
+extern RetainedData retained;
+
+void initRetained();
@@ -0,0 +1,17 @@
+#pragma once
+#include "Arduino.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "scheduler.h"
+#include "utils.h"
+
+#define SAADC_RING_SIZE 8               //Samples kept in the EasyDMA ring
+#define SAADC_NO_SAMPLE INT16_MIN       //Marks a ring entry that hasn't been written yet (a 12 bit result can't be this)
+#define SAADC_SAMPLE_PPI_CHANNEL 9      //Hardware tick -> SAMPLE (channel 8 is the SPI single byte workaround)
+#define SAADC_RESTART_PPI_CHANNEL 10    //END -> START, so the ring restarts without the CPU
+#define SAADC_CALIBRATE_TIMEOUT_MS 10
+#define SAADC_FULL_SCALE_MV 3600        //0.6V internal reference with 1/6 gain
+#define SAADC_MAX_VALUE 4096            //12 bit
+
+void initSAADC(uint8_t pin, uint32_t samplePeriodMS);
+uint8_t getSAADCSamples(int16_t* samples);
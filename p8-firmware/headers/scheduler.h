@@ -0,0 +1,60 @@
+#pragma once
+#include "Arduino.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "utils.h"
+
+#define NO_TASK 0xFF                //Returned by addTask() if the task table is full
+#define SCHEDULER_IRQ_PRIORITY 3    //Lower than the input interrupts, the handler only exists to wake the CPU
+#define SCHEDULER_MIN_TICKS 3       //A compare value closer than this to the counter might be missed, so the task is treated as due
+#define SCHEDULER_TICKS() (NRF_RTC2->COUNTER)
+#define HARDWARE_TICK_CC 1          //RTC2 compare register used for the hardware tick (CC[0] is the task deadline)
+
+#define TASK_AWAKE_ONLY false   //Task is held whilst the watch is asleep (and runs as soon as it wakes)
+#define TASK_ALWAYS true        //Task also runs whilst the watch is asleep
+
+typedef void (*TaskFunction)();
+
+/* 
+  Every task that is registered with addTask(), which sizes the task table. A task that isn't listed here can find the
+  table full (addTask() returns NO_TASK, and it never runs), so add new tasks to the list
+ */
+enum SchedulerTaskSlots {
+  TASK_SLOT_COROUTINES,        //coroutine.cpp
+  TASK_SLOT_BATTERY,           //ioControl.cpp
+  TASK_SLOT_SCREEN_REFRESH,    //screenController.cpp
+  TASK_SLOT_SLEEP_TIMEOUT,     //powerControl.cpp
+  TASK_SLOT_BUTTON_SETTLE,     //button.cpp
+  TASK_SLOT_BUTTON_LONG_PRESS,
+  TASK_SLOT_GOVERNOR,          //governor.cpp
+  TASK_SLOT_POWER_MODEL,       //powerModel.cpp
+  TASK_SLOT_SWITCH_OFF,        //deepSleep.cpp
+  TASK_SLOT_DEEP_SLEEP_CHECK,  //Only registered with DEEP_SLEEP_AUTO
+  MAX_SCHEDULER_TASKS
+};
+
+/* 
+  A task that runs from the main loop at (or just after) its deadline
+  deadline = RTC2 tick at which the task is next due
+  period = ticks between runs, or 0 for a one shot task that has to be scheduled again with scheduleTask()
+  scheduled = whether the task has a deadline at all
+  whenAsleep = whether the task is run whilst the watch is asleep (see TASK_ definitions)
+ */
+typedef struct {
+  TaskFunction function;
+  uint32_t deadline;
+  uint32_t period;
+  bool scheduled;
+  bool whenAsleep;
+} SchedulerTask;
+
+void initScheduler();
+uint8_t addTask(TaskFunction function, uint32_t periodMS, uint32_t delayMS, bool whenAsleep = TASK_AWAKE_ONLY);
+void scheduleTask(uint8_t task, uint32_t delayMS);
+void scheduleTaskAt(uint8_t task, uint32_t tick);
+void setTaskPeriod(uint8_t task, uint32_t periodMS);
+void cancelTask(uint8_t task);
+void runScheduledTasks();
+bool armNextDeadline();
+uint32_t startHardwareTick(uint32_t periodMS);
+void setHardwareTickPeriod(uint32_t periodMS);
@@ -1,18 +1,37 @@
 #pragma once
 #include "Arduino.h"
 #include "Screens.h"
+#include "button.h"
+#include "drag.h"
 #include "font.h"
+#include "hitRegions.h"
+#include "overlay.h"
+#include "scheduler.h"
+#include "touch.h"
 #include "utils.h"
+#include "watchdog.h"
 
 void initScreen();
+void updateScreenUpdateTime();
+uint8_t getHomeScreenIndex();
+void setHomeScreenIndex(uint8_t index);
+void setMinScreenUpdateMS(uint16_t updateMS);
 void screenControllerLoop();
+void refreshScreenNow();
 void handleTap(uint8_t x, uint8_t y);
+void releasePressedRegion(bool now);
 void handleLeftSwipe();
 void handleRightSwipe();
 void handleUpSwipe();
 void handleDownSwipe();
-void handleButtonPress();
+void handleButtonAction(uint8_t action);
 void handleLongTap(uint8_t x, uint8_t y);
+void handleGesture(TouchDataStruct* touchData);
+void handleTouchSample(TouchDataStruct* touchData, uint32_t tick);
 void drawAppIndicator();
+void addAppDrawerHitRegions();
+void unscrollScreen();
+void repaintScreenRegion(coord pos, uint8_t w, uint8_t h);
+void checkLowBattery();
 void prevScreen();
 void nextScreen();
\ No newline at end of file
@@ -1,11 +1,15 @@
 #pragma once
-#include <Wire.h>
-
 #include "Arduino.h"
+#include "coroutine.h"
 #include "ioControl.h"
 #include "pinout.h"
+#include "i2c.h"
 #include "utils.h"
 
+#define TOUCH_ADDRESS 0x15
+#define TOUCH_READ_LENGTH 6
+#define TOUCH_REG_DATA 0x01  //First data register (gesture), the rest of the touch data follows it
+
 #define NO_GESTURE 0x00
 #define SWIPE_DOWN 0x01
 #define SWIPE_UP 0x02
@@ -15,20 +19,52 @@
 #define DOUBLE_TAP 0x0B
 #define LONG_PRESS 0x0C
 
+//Touch event (top 2 bits of the x position high byte)
+#define TOUCH_EVENT_DOWN 0
+#define TOUCH_EVENT_UP 1
+#define TOUCH_EVENT_CONTACT 2
+
+/* 
+  In gesture mode, the controller only sends an interrupt when it has recognised a gesture
+  In stream mode, it also sends an interrupt at its report rate whilst a finger is down, so the finger can be tracked
+ */
+#define TOUCH_MODE_GESTURE 0
+#define TOUCH_MODE_STREAM 1
+#define TOUCH_MODE_UNKNOWN 0xFF  //After a reset, the controller is back in its default mode
+
+//Interrupt control register (same register map as the CST816S)
+#define TOUCH_REG_IRQ_CTL 0xFA
+#define TOUCH_IRQ_EN_TOUCH 0x40   //Interrupt periodically whilst touched
+#define TOUCH_IRQ_EN_CHANGE 0x20  //Interrupt when the touch state changes
+#define TOUCH_IRQ_EN_MOTION 0x10  //Interrupt when a gesture is recognised
+
 /* 
   This struct will hold the data collected from the touch controller
   x = touch x position
   y = touch y position
   gesture = byte representing the gesture (see definitions)
+  event = down, up or contact (see definitions)
+  fingers = number of fingers on the panel
  */
 typedef struct {
   uint8_t gesture;
   uint8_t x;
   uint8_t y;
+  uint8_t event;
+  uint8_t fingers;
 } TouchDataStruct;
 
-void initTouch();
-void resetTouchController(bool bootup = false);
-void updateTouchStruct();
+CoTask* initTouch();
+CoTask* resetTouchController(bool bootup = false);
+uint8_t touchResetSequence(CoTask* co);
+void startTouchRead(uint32_t edgeTick);
+void touchReadComplete(bool success, void* context);
+void parseTouchData(uint8_t* readBuf, TouchDataStruct* sample);
+uint32_t getTouchLatencyUS(bool getMax = false);
 TouchDataStruct* getTouchDataStruct();
-void sleepTouchController();
\ No newline at end of file
+CoTask* sleepTouchController();
+uint8_t touchSleepSequence(CoTask* co);
+bool isTouchSequenceRunning();
+void setTouchMode(uint8_t mode);
+uint8_t getTouchMode();
+void applyTouchMode();
\ No newline at end of file
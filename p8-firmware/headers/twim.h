@@ -0,0 +1,18 @@
+#pragma once
+#include "Arduino.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "pinout.h"
+#include "utils.h"
+
+#define TWIM_IRQ_PRIORITY 1  //Same as GPIOTE, so the two handlers never preempt each other (both push into the interrupt event queue)
+
+/* 
+  Called from the TWIM interrupt handler when a transfer finishes
+  success is false if the device didn't respond (NACK) or there was a bus error
+ */
+typedef void (*TWIMCallback)(bool success);
+
+void initTWIM();
+bool twimTransfer(uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength, TWIMCallback callback);
+bool twimIsBusy();
@@ -4,9 +4,21 @@
 #define STR_WIDTH(str, size) ((sizeof(str) - 1) * size * FONT_WIDTH + (sizeof(str) - 2) * size)  //Macro to get the display width of a string literal
 #define NCHAR_WIDTH(numChars, size) (numChars * size * FONT_WIDTH + (numChars - 1) * size)       //Macro to get the display width of n characters
 
+/* 
+  Timestamps are taken from RTC1 (the RTC that millis() is built on), which counts at 32768Hz and is 24 bits wide
+  It keeps running when the CPU sleeps, and can be read from an interrupt handler
+ */
+#define RTC_TICKS() (NRF_RTC1->COUNTER)
+#define RTC_TICK_DIFF(later, earlier) (((later) - (earlier)) & 0xFFFFFF)  //Difference between two tick counts, handling wrap around
+#define RTC_TICKS_TO_MS(ticks) (((uint32_t)(ticks) * 1000) >> 15)
+#define RTC_TICKS_TO_US(ticks) (((uint64_t)(ticks) * 1000000) >> 15)
+#define MS_TO_RTC_TICKS(ms) (((uint32_t)(ms) << 15) / 1000)  //Only valid up to 131 seconds
+
 /* 
   This structure is used for positions
  */
 typedef struct {
   uint8_t x, y;
-} coord;
\ No newline at end of file
+} coord;
+
+uint16_t isqrt(uint32_t value);
@@ -7,8 +7,21 @@
 #include "nrf52.h"
 #include "nrf52_bitfields.h"
 #include "pinout.h"
+#include "retained.h"
 #include "utils.h"
 
+//Watchdog reload register of each subsystem
+#define WATCHDOG_CHANNEL_RENDER 0   //Screen refresh task
+#define WATCHDOG_CHANNEL_INPUT 1    //Main loop (interrupt event handling)
+#define WATCHDOG_CHANNEL_SENSORS 2  //Accelerometer and heart rate sensor
+#define WATCHDOG_CHANNEL_BLE 3
+#define WATCHDOG_NUM_CHANNELS 4
+#define WATCHDOG_CHANNEL_BIT(channel) (1 << (channel))
+#define WATCHDOG_ALL_CHANNELS ((1 << WATCHDOG_NUM_CHANNELS) - 1)
+#define WATCHDOG_IRQ_PRIORITY 2  //Highest priority the app can use, the SoftDevice reserves 0, 1 and 4 once BLE is enabled
+
 void initWatchdog();
 void enableWatchdog(int timeoutMillis);
+void watchdogCheckIn(uint8_t channel);
+void parkWatchdogChannel(uint8_t channel, bool parked);
 void feedWatchdog();
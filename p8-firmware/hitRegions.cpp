@@ -0,0 +1,122 @@
+#include "headers/hitRegions.h"
+
+/*
+  Rather than every screen testing a tap against an if-chain of rectangles, screens register
+  their buttons as hit regions in screenSetup()
+  To make lookup O(1) regardless of how many regions there are, the display is split into a grid of
+  8*8 pixel cells, and each cell holds the index of the only region that touches it (or EMPTY / SHARED)
+  A tap then only has to read one cell and do one bounds check. Only taps that land in a cell touched
+  by multiple regions (ie the edges of neighbouring buttons) fall back to searching the region list
+ */
+
+HitRegion hitRegions[MAX_HIT_REGIONS];
+uint8_t numHitRegions = 0;
+uint8_t hitGrid[HIT_GRID_SIZE * HIT_GRID_SIZE];  //900 bytes
+uint8_t hitRegionGeneration = 0;                 //Incremented every time the regions are cleared (ie on a screen change)
+
+/*
+  Remove every region and empty the grid, called before a new screen is set up
+ */
+void clearHitRegions() {
+  numHitRegions = 0;
+  memset(hitGrid, HIT_GRID_EMPTY, sizeof(hitGrid));
+  hitRegionGeneration++;
+}
+
+/*
+  Register a region, returning its index (or NO_HIT_REGION if the table is full)
+  Regions added later are "on top" of regions added earlier
+ */
+uint8_t addHitRegion(coord pos, uint8_t w, uint8_t h, uint8_t regionID, HitRegionHandler handler, uint8_t lineWidth, uint16_t colour) {
+  if (numHitRegions >= MAX_HIT_REGIONS || w == 0 || h == 0)
+    return NO_HIT_REGION;
+  uint8_t index = numHitRegions++;
+  hitRegions[index] = {pos, w, h, regionID, lineWidth, colour, handler, pos, w, h};
+
+  //Mark every grid cell that the region overlaps
+  uint8_t startCol = pos.x / HIT_GRID_CELL_SIZE;
+  uint8_t startRow = pos.y / HIT_GRID_CELL_SIZE;
+  uint8_t endCol = (pos.x + w - 1) / HIT_GRID_CELL_SIZE;
+  uint8_t endRow = (pos.y + h - 1) / HIT_GRID_CELL_SIZE;
+  if (endCol >= HIT_GRID_SIZE)
+    endCol = HIT_GRID_SIZE - 1;
+  if (endRow >= HIT_GRID_SIZE)
+    endRow = HIT_GRID_SIZE - 1;
+  for (uint8_t row = startRow; row <= endRow; row++) {
+    for (uint8_t col = startCol; col <= endCol; col++) {
+      uint8_t* cell = &hitGrid[row * HIT_GRID_SIZE + col];
+      *cell = (*cell == HIT_GRID_EMPTY) ? index : HIT_GRID_SHARED;
+    }
+  }
+  return index;
+}
+
+/*
+  Draw the pressed feedback round a smaller rectangle than the region (eg a button with a generous tap area around it)
+ */
+void setHitRegionOutline(uint8_t index, coord pos, uint8_t w, uint8_t h) {
+  if (index >= numHitRegions)
+    return;
+  hitRegions[index].outlinePos = pos;
+  hitRegions[index].outlineW = w;
+  hitRegions[index].outlineH = h;
+}
+
+/*
+  Check whether (x, y) is inside a region
+ */
+static bool isInHitRegion(HitRegion* region, uint8_t x, uint8_t y) {
+  return x >= region->pos.x && x < region->pos.x + region->w && y >= region->pos.y && y < region->pos.y + region->h;
+}
+
+/*
+  Get the index of the region at (x, y), or NO_HIT_REGION if there isn't one
+ */
+uint8_t findHitRegion(uint8_t x, uint8_t y) {
+  if (x >= 240 || y >= 240)
+    return NO_HIT_REGION;
+  uint8_t cell = hitGrid[(y / HIT_GRID_CELL_SIZE) * HIT_GRID_SIZE + (x / HIT_GRID_CELL_SIZE)];
+  if (cell == HIT_GRID_EMPTY)
+    return NO_HIT_REGION;
+  if (cell != HIT_GRID_SHARED)  //Only one region touches this cell, so it is just a bounds check
+    return isInHitRegion(&hitRegions[cell], x, y) ? cell : NO_HIT_REGION;
+  //Shared cell, search from the top-most region down
+  for (int8_t i = numHitRegions - 1; i >= 0; i--) {
+    if (isInHitRegion(&hitRegions[i], x, y))
+      return i;
+  }
+  return NO_HIT_REGION;
+}
+
+/*
+  Get a pointer to the region at index
+ */
+HitRegion* getHitRegion(uint8_t index) {
+  return &hitRegions[index];
+}
+
+/*
+  Get the current generation of regions
+  A handler that changes screen will clear the regions, so comparing the generation before and after
+  calling a handler tells the caller whether the region it is holding is still valid
+ */
+uint8_t getHitRegionGeneration() {
+  return hitRegionGeneration;
+}
+
+/*
+  Redraw only the outline of a region, in the pressed colour or its normal colour
+  This is 4 thin rects, so the cost is proportional to the perimeter of the region rather than the screen
+ */
+void drawHitRegionOutline(uint8_t index, bool pressed) {
+  HitRegion* region = &hitRegions[index];
+  if (region->lineWidth == 0)
+    return;
+  uint16_t colour = pressed ? HIT_REGION_PRESSED_COLOUR : region->colour;
+  coord pos = region->outlinePos;
+  uint8_t w = region->outlineW, h = region->outlineH;
+  drawFilledRect({pos.x, pos.y}, w, region->lineWidth, colour);
+  drawFilledRect({pos.x, pos.y + h - region->lineWidth}, w, region->lineWidth, colour);
+  drawFilledRect({pos.x, pos.y}, region->lineWidth, h, colour);
+  drawFilledRect({pos.x + w - region->lineWidth, pos.y}, region->lineWidth, h, colour);
+}
@@ -0,0 +1,305 @@
+#include "headers/i2c.h"
+
+/*
+  Scheduler for the shared sensor I2C bus (pins 6/7: touch controller, accelerometer and heart rate sensor)
+  Every device submits transactions here rather than using the TWIM driver directly, so one device can't starve another
+  Transactions are queued with a priority, and whenever the bus becomes free the highest priority (then oldest)
+  transaction is started. Submission never blocks, and the callback is run from the TWIM interrupt handler when it finishes
+  A transfer that has started can't be interrupted, so a touch read may still wait for one sensor transfer to finish,
+  but it will never wait behind a queue of them
+  If the next transaction is a register read, any other queued reads of the following registers on the same device are
+  merged into it, so back-to-back reads (eg of consecutive sensor registers) use one bus transaction
+  Bus time is recorded per device, so we can see which device is using the bus
+ */
+
+typedef struct {
+  bool inUse;
+  bool active;  //Part of the transfer that is on the bus right now
+  uint8_t priority;
+  uint32_t sequence;  //Submission order, so transactions of the same priority are done first come first served
+  uint8_t address;
+  uint8_t* txBuf;
+  uint8_t txLength;
+  uint8_t* rxBuf;
+  uint8_t rxLength;
+  bool isRegisterRead;  //txBuf is just the register address, so this can be batched with other reads
+  uint8_t writeBuf[I2C_MAX_WRITE_LENGTH + 1];
+  I2CCallback callback;
+  void* context;
+} I2CTransaction;
+
+I2CTransaction i2cQueue[I2C_QUEUE_SIZE];
+uint32_t i2cSequence = 0;
+volatile bool i2cBusy = false;
+uint32_t i2cTransferStartTick;
+
+I2CTransaction* i2cBatch[I2C_QUEUE_SIZE];  //The transactions in the current bus transfer
+uint8_t i2cBatchCount = 0;
+uint8_t i2cBatchBuffer[I2C_BATCH_BUFFER_SIZE];  //Read destination when several reads have been merged
+
+I2CDeviceStats i2cDeviceStats[I2C_MAX_DEVICES];
+uint8_t i2cNumDevices = 0;
+
+static void i2cTransferComplete(bool success);
+
+/* 
+  Get the bus statistics of a device (they are created the first time a device uses the bus)
+  Returns NULL if the device has never used the bus
+ */
+I2CDeviceStats* getI2CDeviceStats(uint8_t address) {
+  for (uint8_t i = 0; i < i2cNumDevices; i++) {
+    if (i2cDeviceStats[i].address == address)
+      return &i2cDeviceStats[i];
+  }
+  return NULL;
+}
+
+/* 
+  Get the bus statistics of the index'th device to use the bus (NULL if there aren't that many)
+ */
+I2CDeviceStats* getI2CDeviceStatsAt(uint8_t index) {
+  return index < i2cNumDevices ? &i2cDeviceStats[index] : NULL;
+}
+
+/* 
+  Record one transaction of a transfer against its device
+  Only the first transaction of a merged read used the bus (ticks), the rest are counted as batched reads
+ */
+static void recordTransaction(uint8_t address, uint32_t ticks, bool success, bool batched) {
+  I2CDeviceStats* stats = getI2CDeviceStats(address);
+  if (stats == NULL) {
+    if (i2cNumDevices >= I2C_MAX_DEVICES)
+      return;
+    stats = &i2cDeviceStats[i2cNumDevices++];
+    *stats = {address, 0, 0, 0, 0, 0};
+  }
+  stats->transactions++;
+  stats->busTicks += ticks;
+  if (batched)
+    stats->batchedReads++;
+  if (ticks > stats->maxTicks)
+    stats->maxTicks = ticks;
+  if (!success)
+    stats->errors++;
+}
+
+/* 
+  Find the highest priority (then oldest) transaction that is waiting
+ */
+static I2CTransaction* findNextTransaction() {
+  I2CTransaction* next = NULL;
+  for (uint8_t i = 0; i < I2C_QUEUE_SIZE; i++) {
+    I2CTransaction* transaction = &i2cQueue[i];
+    if (!transaction->inUse || transaction->active)
+      continue;
+    if (next == NULL || transaction->priority < next->priority ||
+        (transaction->priority == next->priority && (int32_t)(transaction->sequence - next->sequence) < 0))
+      next = transaction;
+  }
+  return next;
+}
+
+/* 
+  Find a waiting register read of the given device that starts at the given register
+ */
+static I2CTransaction* findFollowingRead(uint8_t address, uint8_t reg) {
+  for (uint8_t i = 0; i < I2C_QUEUE_SIZE; i++) {
+    I2CTransaction* transaction = &i2cQueue[i];
+    if (transaction->inUse && !transaction->active && transaction->isRegisterRead && transaction->address == address && transaction->writeBuf[0] == reg)
+      return transaction;
+  }
+  return NULL;
+}
+
+/* 
+  Start the next transaction on the bus (must be called with interrupts masked, or from the TWIM interrupt handler)
+ */
+static void startNextTransaction() {
+  I2CTransaction* next = findNextTransaction();
+  if (next == NULL) {
+    i2cBusy = false;
+    return;
+  }
+  i2cBusy = true;
+  next->active = true;
+  i2cBatch[0] = next;
+  i2cBatchCount = 1;
+
+  uint8_t* rxBuf = next->rxBuf;
+  uint8_t rxLength = next->rxLength;
+  if (next->isRegisterRead) {
+    //Merge any reads that carry on from where this read ends
+    I2CTransaction* following;
+    while ((following = findFollowingRead(next->address, next->writeBuf[0] + rxLength)) != NULL && rxLength + following->rxLength <= I2C_BATCH_BUFFER_SIZE) {
+      following->active = true;
+      i2cBatch[i2cBatchCount++] = following;
+      rxLength += following->rxLength;
+    }
+    if (i2cBatchCount > 1)
+      rxBuf = i2cBatchBuffer;
+  }
+  i2cTransferStartTick = RTC_TICKS();
+  twimTransfer(next->address, next->txBuf, next->txLength, rxBuf, rxLength, i2cTransferComplete);
+}
+
+/* 
+  Called by the TWIM driver when the current transfer is done
+  The results of a merged read are split back out to each transaction, the next transaction is started, and then
+  the callbacks are run (so the bus isn't idle whilst the callbacks run)
+ */
+static void i2cTransferComplete(bool success) {
+  uint32_t busTicks = RTC_TICK_DIFF(RTC_TICKS(), i2cTransferStartTick);
+
+  I2CCallback callbacks[I2C_QUEUE_SIZE];
+  void* contexts[I2C_QUEUE_SIZE];
+  uint8_t numCallbacks = i2cBatchCount;
+  uint8_t offset = 0;
+  for (uint8_t i = 0; i < i2cBatchCount; i++) {
+    I2CTransaction* transaction = i2cBatch[i];
+    recordTransaction(transaction->address, i == 0 ? busTicks : 0, success, i > 0);
+    if (i2cBatchCount > 1 && success)
+      memcpy(transaction->rxBuf, i2cBatchBuffer + offset, transaction->rxLength);
+    offset += transaction->rxLength;
+    callbacks[i] = transaction->callback;
+    contexts[i] = transaction->context;
+    transaction->active = false;
+    transaction->inUse = false;
+  }
+  startNextTransaction();
+  for (uint8_t i = 0; i < numCallbacks; i++) {
+    if (callbacks[i] != NULL)
+      callbacks[i](success, contexts[i]);
+  }
+}
+
+/* 
+  Add a transaction to the queue, starting it if the bus is free
+  Returns the queued transaction (so the caller can fill in its write buffer), or NULL if the queue is full
+  Must be called with interrupts masked
+ */
+static I2CTransaction* queueTransaction(uint8_t address, uint8_t priority, I2CCallback callback, void* context) {
+  for (uint8_t i = 0; i < I2C_QUEUE_SIZE; i++) {
+    I2CTransaction* transaction = &i2cQueue[i];
+    if (transaction->inUse)
+      continue;
+    transaction->inUse = true;
+    transaction->active = false;
+    transaction->priority = priority;
+    transaction->sequence = i2cSequence++;
+    transaction->address = address;
+    transaction->isRegisterRead = false;
+    transaction->callback = callback;
+    transaction->context = context;
+    return transaction;
+  }
+  return NULL;
+}
+
+/* 
+  Queue a raw transfer: write txLength bytes then read rxLength bytes
+  Both buffers must be in RAM and stay valid until the callback is called
+  Can be called from an interrupt handler. Returns false if the queue is full
+ */
+bool i2cTransfer(uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength, uint8_t priority, I2CCallback callback, void* context) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  I2CTransaction* transaction = queueTransaction(address, priority, callback, context);
+  if (transaction != NULL) {
+    transaction->txBuf = txBuf;
+    transaction->txLength = txLength;
+    transaction->rxBuf = rxBuf;
+    transaction->rxLength = rxLength;
+    if (!i2cBusy)
+      startNextTransaction();
+  }
+  __set_PRIMASK(primask);
+  return transaction != NULL;
+}
+
+/* 
+  Queue a read of length registers starting at reg. rxBuf must stay valid until the callback is called
+ */
+bool i2cReadRegisters(uint8_t address, uint8_t reg, uint8_t* rxBuf, uint8_t length, uint8_t priority, I2CCallback callback, void* context) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  I2CTransaction* transaction = queueTransaction(address, priority, callback, context);
+  if (transaction != NULL) {
+    transaction->writeBuf[0] = reg;
+    transaction->txBuf = transaction->writeBuf;
+    transaction->txLength = 1;
+    transaction->rxBuf = rxBuf;
+    transaction->rxLength = length;
+    transaction->isRegisterRead = true;
+    if (!i2cBusy)
+      startNextTransaction();
+  }
+  __set_PRIMASK(primask);
+  return transaction != NULL;
+}
+
+/* 
+  Queue a write of up to I2C_MAX_WRITE_LENGTH registers starting at reg
+  The data is copied, so it doesn't need to stay valid (or be in RAM)
+ */
+bool i2cWriteRegisters(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length, uint8_t priority, I2CCallback callback, void* context) {
+  if (length > I2C_MAX_WRITE_LENGTH)
+    return false;
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  I2CTransaction* transaction = queueTransaction(address, priority, callback, context);
+  if (transaction != NULL) {
+    transaction->writeBuf[0] = reg;
+    memcpy(transaction->writeBuf + 1, data, length);
+    transaction->txBuf = transaction->writeBuf;
+    transaction->txLength = length + 1;
+    transaction->rxBuf = NULL;
+    transaction->rxLength = 0;
+    if (!i2cBusy)
+      startNextTransaction();
+  }
+  __set_PRIMASK(primask);
+  return transaction != NULL;
+}
+
+/* 
+  The blocking versions queue the transaction and wait for it to finish
+  These are for setup code in the main loop, and must never be called from an interrupt handler
+  (the transaction could never finish, since the TWIM interrupt can't run)
+ */
+static void blockingTransactionComplete(bool success, void* context) {
+  *(volatile int8_t*)context = success ? 1 : 0;
+}
+
+bool i2cTransferBlocking(uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength, uint8_t priority) {
+  volatile int8_t result = -1;
+  while (!i2cTransfer(address, txBuf, txLength, rxBuf, rxLength, priority, blockingTransactionComplete, (void*)&result))
+    ;  //Queue is full, wait for space
+  while (result < 0)
+    ;
+  return result == 1;
+}
+
+bool i2cReadRegistersBlocking(uint8_t address, uint8_t reg, uint8_t* rxBuf, uint8_t length, uint8_t priority) {
+  volatile int8_t result = -1;
+  while (!i2cReadRegisters(address, reg, rxBuf, length, priority, blockingTransactionComplete, (void*)&result))
+    ;
+  while (result < 0)
+    ;
+  return result == 1;
+}
+
+bool i2cWriteRegistersBlocking(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length, uint8_t priority) {
+  volatile int8_t result = -1;
+  while (!i2cWriteRegisters(address, reg, data, length, priority, blockingTransactionComplete, (void*)&result))
+    ;
+  while (result < 0)
+    ;
+  return result == 1;
+}
+
+/* 
+  Check whether there is nothing on the bus or waiting for it
+ */
+bool i2cIsIdle() {
+  return !i2cBusy;
+}
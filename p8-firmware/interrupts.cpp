@@ -1,10 +1,27 @@
 #include "headers/interrupts.h"
 
-#define BUTTON_WAIT_DELAY_AFTER_WAKE_MS 300
-bool pendingButtonInt = false;
-bool pendingTouchInt = false;
-bool lastButtonState;
-bool lastTouchState;
+/* 
+  Every pin that can interrupt is registered as an event source (see addGPIOEventSource())
+  The GPIO is in latched detect mode, so when a pin meets its sense condition its bit is held in NRF_GPIO->LATCH, and
+  the interrupt handler finds every pin that changed from that one read rather than reading each pin and comparing
+  it with the last state. The sense level tells the handler which edge it was, and is flipped to re-arm the pin
+ */
+GPIOEventSource gpioSources[MAX_GPIO_EVENT_SOURCES];
+uint8_t numGPIOSources = 0;
+uint8_t pinSourceIndex[32];     //Index into gpioSources for each pin
+uint32_t gpioSourcePinMask = 0;  //Pins that have been registered
+
+/* 
+  Events are passed from the interrupt handler to the main loop through a ring buffer
+  The interrupt handlers are the only writers of eventQueueHead, and the main loop is the only writer of eventQueueTail,
+  so no locking is needed (single producer, single consumer). The GPIOTE and TWIM handlers both push events, but they
+  run at the same priority so can never interrupt each other, meaning they act as a single producer. Both indexes count up forever (wrapping at 256)
+  and are masked when indexing, so the number of queued events is just head - tail
+ */
+InterruptEvent eventQueue[EVENT_QUEUE_SIZE];
+volatile uint8_t eventQueueHead = 0;
+volatile uint8_t eventQueueTail = 0;
+volatile uint32_t eventQueueOverflows = 0;
 
 /*
   Initialize interrupts using a GPIO port for reduced power draw
@@ -19,24 +36,98 @@ void initInterrupts() {
   //We use the port based interrupt to reduce power draw
   NRF_GPIOTE->EVENTS_PORT = 1;
   NRF_GPIOTE->INTENSET = GPIOTE_INTENSET_PORT_Msk;
+  NRF_GPIO->DETECTMODE = GPIO_DETECTMODE_DETECTMODE_LDETECT << GPIO_DETECTMODE_DETECTMODE_Pos;
+
+  memset(pinSourceIndex, 0xFF, sizeof(pinSourceIndex));
+  addGPIOEventSource(TP_INT, EVENT_SOURCE_TOUCH, EDGE_MASK_FALLING, touchEdge);  //The data is read straight away (see touch.cpp)
+  addGPIOEventSource(PUSH_BUTTON_IN, EVENT_SOURCE_BUTTON, EDGE_MASK_BOTH);        //Both edges go to the debouncer (see button.cpp)
+}
+
+/* 
+  Register a pin as an event source (the pin must already be configured as an input)
+  source = the EVENT_SOURCE pushed for the pin's edges
+  edges = which edges are reported (see EDGE_MASK definitions), the pin is re-armed on both regardless
+  handler = if not NULL, called from the interrupt handler instead of pushing an event
+  Returns false if the table is full or the pin is already registered
+ */
+bool addGPIOEventSource(uint8_t pin, uint8_t source, uint8_t edges, GPIOEdgeHandler handler) {
+  if (numGPIOSources >= MAX_GPIO_EVENT_SOURCES || pin >= 32 || (gpioSourcePinMask & (1UL << pin)))
+    return false;
+  NVIC_DisableIRQ(GPIOTE_IRQn);
+  gpioSources[numGPIOSources] = {pin, source, edges, handler};
+  pinSourceIndex[pin] = numGPIOSources++;
+  //Sense the opposite of the current level, so the first transition latches
+  bool level = (NRF_GPIO->IN >> pin) & 1;
+  NRF_GPIO->PIN_CNF[pin] &= ~GPIO_PIN_CNF_SENSE_Msk;
+  NRF_GPIO->PIN_CNF[pin] |= ((level ? GPIO_PIN_CNF_SENSE_Low : GPIO_PIN_CNF_SENSE_High) << GPIO_PIN_CNF_SENSE_Pos);
+  NRF_GPIO->LATCH = 1UL << pin;
+  gpioSourcePinMask |= 1UL << pin;
+  NVIC_EnableIRQ(GPIOTE_IRQn);
+  return true;
+}
+
+/* 
+  Called from the interrupt handler on the falling edge of the touch interrupt
+ */
+void touchEdge(uint8_t edge, uint32_t tick) {
+  startTouchRead(tick);
+}
 
-  lastButtonState = digitalRead(PUSH_BUTTON_IN);
-  NRF_GPIO->PIN_CNF[PUSH_BUTTON_IN] |= ((lastButtonState ? GPIO_PIN_CNF_SENSE_Low : GPIO_PIN_CNF_SENSE_High) << GPIO_PIN_CNF_SENSE_Pos);
+/* 
+  Add an event to the queue, timestamped with the given RTC tick
+  Must only be called from an interrupt handler at the GPIOTE priority (the single producer)
+ */
+bool pushInterruptEvent(uint8_t source, uint8_t edge, uint32_t tick, TouchDataStruct* touch) {
+  uint8_t head = eventQueueHead;
+  if ((uint8_t)(head - eventQueueTail) >= EVENT_QUEUE_SIZE) {  //Queue full, the event is dropped and counted
+    eventQueueOverflows++;
+    return false;
+  }
+  InterruptEvent* event = &eventQueue[head & (EVENT_QUEUE_SIZE - 1)];
+  event->source = source;
+  event->edge = edge;
+  event->tick = tick;
+  if (touch != NULL)
+    event->touch = *touch;
+  __DMB();  //Make sure the event is written before it is published to the main loop
+  eventQueueHead = head + 1;
+  return true;
+}
 
-  lastTouchState = digitalRead(TP_INT);
-  NRF_GPIO->PIN_CNF[TP_INT] |= (GPIO_PIN_CNF_SENSE_Low << GPIO_PIN_CNF_SENSE_Pos);
+/* 
+  Take the oldest event from the queue, returning false if there are none
+  Must only be called from the main loop (the single consumer)
+ */
+bool popInterruptEvent(InterruptEvent* event) {
+  uint8_t tail = eventQueueTail;
+  if (tail == eventQueueHead)
+    return false;
+  __DMB();  //Make sure the event is read after seeing the new head
+  *event = eventQueue[tail & (EVENT_QUEUE_SIZE - 1)];
+  __DMB();  //Make sure the event is copied before the slot is given back to the interrupt handler
+  eventQueueTail = tail + 1;
+  return true;
+}
+
+/* 
+  Get the number of events that have been dropped because the queue was full
+ */
+uint32_t getEventQueueOverflows() {
+  return eventQueueOverflows;
 }
 
 /* 
   The interrupt handler works as follows:
-  If the handler routine (below) is called, we know that there has been a change in state of any pin configured
-  So we first check which pin was set that sent the interrupt for each pin configured to send an interrupt,
-  then we change the interrupt configuration on that pin to only trigger when the inverse of the current read 
-  value is seen. This means that an interrupt will only fire on a TRANSITION of state of any of the interrupt pins.
-  This is effectively the same behaviour as GPIOTE LoToHi or HiToLo interrupts, however it has the added benefit 
-  of drawing less power.
-  Finally we only set the specific interrupt flag if the correct state of the interrupt is seen, for example
-  only setting a button interrupt when the button is HIGH (since the button is active high) 
+  The port event fires when any bit of NRF_GPIO->LATCH is set, ie when any registered pin meets its sense condition
+  Each latched pin is handled in turn: the sense condition it met gives the edge (sensing high means it rose), then the
+  sense is flipped to the opposite level and the latch bit cleared. If the pin has already gone back, it meets the new
+  sense condition straight away and latches again, so a quick press and release is still seen as two edges. If any
+  latch bit is still set after clearing, the hardware generates another port event, so nothing is missed between
+  reading LATCH and clearing it
+  This gives the same behaviour as GPIOTE LoToHi or HiToLo interrupts, however it has the added benefit of drawing less
+  power, and the cost doesn't depend on the number of sources
+  Finally every reported edge is pushed into the event queue with a timestamp (or passed to the source's handler), so
+  that a touch and a button press (or repeated presses) between two runs of the main loop are all seen, in order
 */
 #ifdef __cplusplus
 extern "C" {
@@ -45,26 +136,23 @@ void GPIOTE_IRQHandler() {
   if ((NRF_GPIOTE->EVENTS_PORT != 0)) {
     NRF_GPIOTE->EVENTS_PORT = 0;  //Reset flag for the port event
 
-    bool touchIntRead = digitalRead(TP_INT);
-    if (touchIntRead != lastTouchState) {  //If there has been a change in state of the touch interrupt
-      //updateTouchStruct();                 //Preemptively update the touch data as quickly as possible
-      lastTouchState = touchIntRead;
-      NRF_GPIO->PIN_CNF[TP_INT] &= ~GPIO_PIN_CNF_SENSE_Msk;
-      NRF_GPIO->PIN_CNF[TP_INT] |= ((lastTouchState ? GPIO_PIN_CNF_SENSE_Low : GPIO_PIN_CNF_SENSE_High) << GPIO_PIN_CNF_SENSE_Pos);
-      if (lastTouchState == LOW) {
-        pendingTouchInt = true;
-      }
-    }
+    uint32_t tick = RTC_TICKS();
+    uint32_t latched = NRF_GPIO->LATCH & gpioSourcePinMask;
+    while (latched != 0) {
+      uint8_t pin = __builtin_ctz(latched);
+      latched &= latched - 1;
+      uint32_t cnf = NRF_GPIO->PIN_CNF[pin];
+      uint8_t edge = ((cnf & GPIO_PIN_CNF_SENSE_Msk) >> GPIO_PIN_CNF_SENSE_Pos) == GPIO_PIN_CNF_SENSE_High ? EDGE_RISING : EDGE_FALLING;
+      NRF_GPIO->PIN_CNF[pin] = cnf ^ ((GPIO_PIN_CNF_SENSE_High ^ GPIO_PIN_CNF_SENSE_Low) << GPIO_PIN_CNF_SENSE_Pos);  //High <-> Low
+      NRF_GPIO->LATCH = 1UL << pin;  //Write 1 to clear
 
-    bool buttonRead = digitalRead(PUSH_BUTTON_IN);
-    if (buttonRead != lastButtonState) {  //If there has been a change in state of the button
-      lastButtonState = buttonRead;       //Set the last state accordingly
-      NRF_GPIO->PIN_CNF[PUSH_BUTTON_IN] &= ~GPIO_PIN_CNF_SENSE_Msk;
-      //Update the interrupt configuration to trigger on the inverse of the current read value (making sure interrupts are only triggered on state TRANSITIONS)
-      NRF_GPIO->PIN_CNF[PUSH_BUTTON_IN] |= ((lastButtonState ? GPIO_PIN_CNF_SENSE_Low : GPIO_PIN_CNF_SENSE_High) << GPIO_PIN_CNF_SENSE_Pos);
-      if (lastButtonState == HIGH) {
-        pendingButtonInt = true;  //If we read a high button press (button is pressed), set the flag
-      }
+      GPIOEventSource* source = &gpioSources[pinSourceIndex[pin]];
+      if (!(source->edges & (1 << edge)))
+        continue;
+      if (source->handler != NULL)
+        source->handler(edge, tick);
+      else
+        pushInterruptEvent(source->source, edge, tick);
     }
   }
   (void)NRF_GPIOTE->EVENTS_PORT;
@@ -74,80 +162,72 @@ void GPIOTE_IRQHandler() {
 #endif
 
 /* 
-This method is called as fast as possible by the main Arduino loop()
+This method is called by the main Arduino loop() every time the CPU wakes
+Every queued event is handled, oldest first
  */
 void handleInterrupts() {
-  //If we have a pending touch interrupt
-  if (pendingTouchInt) {
-#ifndef P8
-    if (getPowerMode() == POWER_OFF && PUSH_BUTTON_OUT != -1) {  //If we have the CST816 use it to wake up
-      exitSleep();
-      resetInterrupts();
-      updateLastWakeTime();
-      return;
+  InterruptEvent event;
+  while (popInterruptEvent(&event)) {
+    if (event.source == EVENT_SOURCE_TOUCH) {  //Touch data that has been read by the interrupt handlers
+      handleTouchEvent(&event);
+    } else if (event.source == EVENT_SOURCE_BUTTON) {  //Both edges go to the debouncer (see button.cpp)
+      buttonEdge(event.edge, event.tick);
+    } else if (event.source == EVENT_SOURCE_CHARGER) {
+      handleChargerEvent(&event);
+    } else if (event.source == EVENT_SOURCE_ACCEL) {  //A tap, or the FIFO has reached the watermark
+      accelInterrupt(event.tick);
     }
-#endif
-    updateTouchStruct();  //Get the touch information
+  }
+}
+
+/* 
+  Dispatch the touch data read by the interrupt handlers as a gesture (or streamed touch) to the screen controller
+ */
+void handleTouchEvent(InterruptEvent *event) {
+#ifndef P8
+  if (getPowerMode() == POWER_OFF && PUSH_BUTTON_OUT != -1) {  //If we have the CST816 use it to wake up
+    exitSleep(event->tick);
     updateLastWakeTime();
+    return;
+  }
+#endif
+  updateLastWakeTime();
+  applyTouchMode();  //The controller is awake now, so make sure it is in the mode the current screen wants
 
-    TouchDataStruct *touchData = getTouchDataStruct();
-    //Handle the touch type
-    switch (touchData->gesture) {
-      case SINGLE_TAP:
-        handleTap(touchData->x, touchData->y);
-        break;
-      case LONG_PRESS:
-        handleLongTap(touchData->x, touchData->y);
-        break;
-      case SWIPE_DOWN:
-        handleDownSwipe();
-        break;
-      case SWIPE_UP:
-        handleUpSwipe();
-        break;
-      case SWIPE_LEFT:
-        handleLeftSwipe();
-        break;
-      case SWIPE_RIGHT:
-        handleRightSwipe();
-        break;
-    }
-    resetInterrupts();
-
-    //If we have a pending button interrupt
-  } else if (pendingButtonInt) {
-    //If we receive a button press whilst powered off, exit sleep and update the wake time
-    if (getPowerMode() == POWER_OFF) {
-      exitSleep();
-      resetInterrupts();
-      updateLastWakeTime();
-      return;
-    }
-    /* 
-      We want to make sure that we only register a button press after a certain period of time
-      so as to reduce the chance of button bouncing being registered as a press 
-    */
-    if (millis() - getLastWakeTime() > BUTTON_WAIT_DELAY_AFTER_WAKE_MS) {
-      //Since we registered a button press, the last wake time must be updated
-      updateLastWakeTime();
-      handleButtonPress();
-      resetInterrupts();
-    } else {
-      resetInterrupts();  //We want to reject any button presses done within the wait period to hopefully stop bouncing
-    }
-  } else {  //If this is called when there is no interrupt, check the wake time and sleep if necessary
-    checkWakeTime();
+  TouchDataStruct *touchData = &event->touch;
+  if (getTouchMode() == TOUCH_MODE_STREAM) {
+    handleTouchSample(touchData, event->tick);  //Track the finger
+  } else {
+    handleGesture(touchData);  //Handle the touch type
   }
+}
 
-  //I left this in and it caused a race condition that would sometimes mean touches were ignored since their flag
-  //would be reset before they were handled. Now the flags are only reset when an interrupt was handled
-  //resetInterrupts();
+/* 
+  The charger was plugged in or unplugged, so the power profile is changed straight away rather than at the
+  governor's next check, and the screen is woken to show it
+ */
+void handleChargerEvent(InterruptEvent *event) {
+  updateGovernor();
+  if (getPowerMode() == POWER_OFF)
+    exitSleep(event->tick);
+  updateLastWakeTime();
 }
 
 /* 
-  Remove any flagged interrupts
+  Called by the accelerometer interrupt coroutine when the accelerometer saw a tap, tick is the RTC tick of the tap
+  A double tap whilst asleep wakes the watch without resetting the touch controller (so a knock that nobody follows up
+  costs no touch power), and a tap of either kind whilst awake means the user is using the watch, so touch is woken
+  Returns true if the tap woke the watch
  */
-void resetInterrupts() {
-  pendingTouchInt = false;
-  pendingButtonInt = false;
-}
\ No newline at end of file
+bool handleAccelTap(bool doubleTap, uint32_t tick) {
+  if (getPowerMode() == POWER_OFF) {
+    if (!doubleTap)
+      return false;
+    exitSleep(tick, false);
+    updateLastWakeTime();
+    return true;
+  }
+  wakeTouch();
+  updateLastWakeTime();
+  return false;
+}
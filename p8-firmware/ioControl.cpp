@@ -1,13 +1,16 @@
 #include "headers/ioControl.h"
 
 int currentBrightness = 0;
-uint16_t avgReading = 0;
-long lastBatCalcTime = 0;
-long lastBatPollTime = 0;
-uint16_t batCounter = 0;
-int cumulativeBatRead = 0;
+int outputBrightness = 0;                //Level the backlight is actually driven at (0 when off)
+int maxBrightness = MAX_BRIGHTNESS;      //Limit set by the power governor
+uint8_t batteryTask = NO_TASK;
+uint16_t filteredBatteryMV = 0;  //Filtered battery voltage (0 until the first samples have been filtered)
 uint16_t lastBatPercent = 69;
 
+//Discharge curve (must be in order of voltage), the percent is linearly interpolated between points
+const BatteryCurvePoint batteryCurve[NUM_BATTERY_CURVE_POINTS] = {
+    {3482, 0}, {3575, 5}, {3609, 10}, {3648, 20}, {3676, 30}, {3703, 40}, {3740, 50}, {3789, 60}, {3850, 70}, {3920, 80}, {4010, 90}, {4145, 99}};
+
 /* IOController* IOController::getInstance() {
   if (!instance)
     instance = new IOController;
@@ -47,6 +50,9 @@ void initIO() {
   pinMode(GREEN_LEDS, OUTPUT);
   pinMode(VIBRATOR_OUT, OUTPUT);
   pinMode(PUSH_BUTTON_IN, INPUT);
+  digitalWrite(LCD_BACKLIGHT_LOW, HIGH);  //Backlight off (active low) whenever the PWM isn't driving the pins
+  digitalWrite(LCD_BACKLIGHT_MID, HIGH);
+  digitalWrite(LCD_BACKLIGHT_HIGH, HIGH);
   pinMode(LCD_BACKLIGHT_LOW, OUTPUT);
   pinMode(LCD_BACKLIGHT_MID, OUTPUT);
   pinMode(LCD_BACKLIGHT_HIGH, OUTPUT);
@@ -66,7 +72,12 @@ void initIO() {
   pinMode(POWER_CONTROL, OUTPUT);
   digitalWrite(POWER_CONTROL, HIGH);
 
+  initBacklight();
   setBrightness(3);
+  initHaptics();
+
+  initSAADC(BATTERY_VOLTAGE, BATTERY_SAMPLE_PERIOD_MS);
+  batteryTask = addTask(updateBatteryPercent, BATTERY_AVERAGE_PERIOD_MS, BATTERY_SAMPLE_PERIOD_MS);
 }
 
 /*
@@ -80,34 +91,38 @@ bool getButtonState() {
 
 /*
   Turn the status LED on or off (LED on the heartrate sensor board)
+  This only has an effect whilst no pattern is playing, as the PWM drives the pin during a pattern (see haptics.cpp)
 */
 void ledOutput(bool on) {
   digitalWrite(GREEN_LEDS, on);
 }
 
 /*
-  Turn the vibration motor on or off
+  Turn the vibration motor on or off (again, only whilst no pattern is playing)
 */
 void motorOutput(bool on) {
   digitalWrite(VIBRATOR_OUT, !on);
 }
 
 /*
-  Set the backlight brightness between 0b000 (low) and 0b111 or 7 (high)
-  Since the backlight pins are active low, we must first invert the brightness
-  Then we get the value of each bit by shifting it accordingly
-  Finally we write that value to the output pin
-  For example: brightness = 4 (100)
-  Invert = 011
-  Shifting yields: LOW = 1, MID = 1, HIGH = 0
+  Set the backlight brightness between 0 (off) and 7 (high) straight away
 */
 void setBrightness(int brightness) {
+  fadeBrightness(brightness, 0);
+}
+
+/*
+  Fade the backlight to a brightness between 0 (off) and 7 (high) over fadeMS (see backlight.cpp)
+  The brightness is limited by the power governor, and the last non zero brightness is remembered for waking up
+*/
+void fadeBrightness(int brightness, uint16_t fadeMS) {
+  if (brightness > maxBrightness)
+    brightness = maxBrightness;
   if (brightness >= 0 && brightness <= 7) {  //Make sure the brightness is in the correct range
+    outputBrightness = brightness;
     if (brightness > 0)
       currentBrightness = brightness;
-    digitalWrite(LCD_BACKLIGHT_LOW, !(brightness & 1));
-    digitalWrite(LCD_BACKLIGHT_MID, !((brightness >> 1) & 1));
-    digitalWrite(LCD_BACKLIGHT_HIGH, !((brightness >> 2) & 1));
+    fadeBacklight(BACKLIGHT_LEVEL_TO_DUTY(brightness), fadeMS);
   }
 }
 
@@ -118,12 +133,24 @@ int getBrightness() {
   return currentBrightness;
 }
 
+/*
+  Limit the brightness (used by the power governor), turning the backlight down straight away if it is above the limit
+  The level is also lowered whilst the backlight is off, so it comes back on at the limit
+*/
+void setMaxBrightness(int brightness) {
+  maxBrightness = brightness;
+  if (currentBrightness > maxBrightness)
+    currentBrightness = maxBrightness;
+  if (outputBrightness > maxBrightness)
+    setBrightness(maxBrightness);
+}
+
 /*
   Increment brightness
 */
 void incBrightness() {
-  if (getBrightness() < 7) {
-    setBrightness(getBrightness() + 1);
+  if (getBrightness() < maxBrightness) {
+    fadeBrightness(getBrightness() + 1, BRIGHTNESS_CHANGE_FADE_MS);
   }
 }
 
@@ -132,73 +159,78 @@ void incBrightness() {
 */
 void decBrightness() {
   if (getBrightness() > 0) {
-    setBrightness(getBrightness() - 1);
+    fadeBrightness(getBrightness() - 1, BRIGHTNESS_CHANGE_FADE_MS);
   }
 }
 
 /* 
-Quickly flash green LEDs for debugging */
+Quickly flash green LEDs for debugging (played by the PWM, so this doesn't wait for it) */
 void ledPing() {
-  digitalWrite(GREEN_LEDS, HIGH);
-  delay(5);
-  digitalWrite(GREEN_LEDS, LOW);
+  playPattern(PATTERN_LED_PING);
 }
 
 /* 
-  Only update the battery percent every 10 seconds to get a more accurate long-term reading
-  every 10 seconds
+  Only update the battery percent every 6 seconds to get a more accurate long-term reading
  */
 uint16_t getBatteryPercent() {
-  if (millis() - lastBatCalcTime > 6000) {
-    lastBatCalcTime = millis();
-    avgReading = cumulativeBatRead / batCounter;
-    cumulativeBatRead = 0;
-    batCounter = 0;
-    lastBatPercent = milliVoltToPercent(avgReading);
-    return lastBatPercent;
-  } else {
-    return lastBatPercent;
-  }
+  return lastBatPercent;
 }
 
 /* 
-  Every 500ms add to the cumulative battery reading 
-*/
-void addToCumulativeBatReading() {
-  if (millis() - lastBatPollTime > 200) {
-    batCounter++;
-    cumulativeBatRead += map(analogRead(BATTERY_VOLTAGE), 496, 696, 3000, 4200);
-    lastBatPollTime = millis();
+  Get the filtered battery voltage in mV
+ */
+uint16_t getBatteryMilliVolts() {
+  return filteredBatteryMV;
+}
+
+/* 
+  Scheduler task (every BATTERY_AVERAGE_PERIOD_MS) that filters the samples the SAADC has taken in the background
+  The median of the ring throws away spikes (eg from the motor or backlight turning on during a sample),
+  then a simple IIR filter smooths the medians so the percent doesn't jump around
+ */
+void updateBatteryPercent() {
+  int16_t samples[SAADC_RING_SIZE];
+  uint8_t count = getSAADCSamples(samples);
+  if (count == 0)  //No samples yet
+    return;
+  //Insertion sort, there are only 8 samples
+  for (uint8_t i = 1; i < count; i++) {
+    int16_t sample = samples[i];
+    int8_t j = i - 1;
+    for (; j >= 0 && samples[j] > sample; j--)
+      samples[j + 1] = samples[j];
+    samples[j + 1] = sample;
   }
+  uint32_t medianMV = ((uint32_t)samples[count / 2] * SAADC_FULL_SCALE_MV * BATTERY_DIVIDER_NUM) / (SAADC_MAX_VALUE * BATTERY_DIVIDER_DEN);
+  if (filteredBatteryMV == 0)
+    filteredBatteryMV = medianMV;
+  else
+    filteredBatteryMV += ((int32_t)medianMV - (int32_t)filteredBatteryMV) >> BATTERY_FILTER_SHIFT;
+  lastBatPercent = milliVoltToPercent(filteredBatteryMV);
 }
 
+/* 
+  Change how often the battery samples are filtered, and the SAADC sample period with it so the ring still covers one filter period
+ */
+void setBatteryUpdatePeriod(uint32_t periodMS) {
+  setTaskPeriod(batteryTask, periodMS);
+  setHardwareTickPeriod(periodMS / SAADC_RING_SIZE);
+}
+
+/* 
+  Convert the battery voltage to a percent by interpolating between the points of the discharge curve
+ */
 uint16_t milliVoltToPercent(int batteryMV) {
-  if (batteryMV >= 4145)
-    return 99;
-  else if (batteryMV > 4010)
-    return (99 - (int16_t)(4145 - batteryMV) / 13);
-  else if (batteryMV > 3920)
-    return (90 - (int16_t)(4010 - batteryMV) / 9);
-  else if (batteryMV > 3850)
-    return (80 - (int16_t)(3920 - batteryMV) / 7);
-  else if (batteryMV > 3789)
-    return (70 - (int16_t)(3850 - batteryMV) / 6);
-  else if (batteryMV > 3740)
-    return (60 - (int16_t)(3789 - batteryMV) / 4);
-  else if (batteryMV > 3703)
-    return (50 - (int16_t)(3740 - batteryMV) / 3);
-  else if (batteryMV > 3676)
-    return (40 - (int16_t)(3703 - batteryMV) / 2);
-  else if (batteryMV > 3648)
-    return (30 - (int16_t)(3676 - batteryMV) / 2);
-  else if (batteryMV > 3609)
-    return (20 - (int16_t)(3648 - batteryMV) / 3);
-  else if (batteryMV > 3575)
-    return (10 - (int16_t)(3609 - batteryMV) / 6);
-  else if (batteryMV > 3482)
-    return (5 - (int16_t)(3575 - batteryMV) / 18);
-  else
-    return 0;
+  if (batteryMV <= batteryCurve[0].milliVolts)
+    return batteryCurve[0].percent;
+  for (uint8_t i = 1; i < NUM_BATTERY_CURVE_POINTS; i++) {
+    const BatteryCurvePoint* upper = &batteryCurve[i];
+    if (batteryMV < upper->milliVolts) {
+      const BatteryCurvePoint* lower = &batteryCurve[i - 1];
+      return lower->percent + (uint32_t)(batteryMV - lower->milliVolts) * (upper->percent - lower->percent) / (upper->milliVolts - lower->milliVolts);
+    }
+  }
+  return batteryCurve[NUM_BATTERY_CURVE_POINTS - 1].percent;
 }
 
 /* 
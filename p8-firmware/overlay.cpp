@@ -0,0 +1,76 @@
+#include "headers/overlay.h"
+
+#include "headers/screenController.h"
+
+/*
+  The overlay is a single modal layer drawn on top of the current screen (for toasts, warnings and notifications)
+  Because there is no spare RAM to hold the pixels that the overlay covers (a 240*40 strip alone would be 19kB),
+  the overlay only remembers the rectangle it covers. When it is dismissed the current screen is asked to
+  repaint just that rectangle (see WatchScreenBase::screenRepaintRegion()), so a popup costs pixels proportional
+  to its own size rather than a clearDisplay() and full screenSetup()
+  Whilst the overlay is visible the screen's loop isn't run (so it can't draw over the overlay), and any input
+  dismisses the overlay instead of going to the screen
+ */
+
+bool overlayVisible = false;
+coord overlayPos;
+uint8_t overlayWidth;
+uint8_t overlayHeight;
+uint16_t overlayTimeoutMS;
+long overlayShownTime;
+
+/*
+  Draw a box with centred text on top of the current screen
+  If timeoutMS is OVERLAY_NO_TIMEOUT the overlay will stay until it is dismissed
+ */
+void showOverlay(coord pos, uint8_t w, uint8_t h, const char* text, uint16_t colour, uint16_t timeoutMS) {
+  if (overlayVisible)  //Only one overlay at a time, so restore whatever the last one covered first
+    dismissOverlay();
+  overlayPos = pos;
+  overlayWidth = w;
+  overlayHeight = h;
+  overlayTimeoutMS = timeoutMS;
+  overlayShownTime = millis();
+  unscrollScreen();  //The overlay is drawn at memory lines, which only match screen rows when nothing is scrolled
+  overlayVisible = true;
+
+  drawUnfilledRect(pos, w, h, OVERLAY_BORDER_WIDTH, colour);
+  uint8_t numChars = strlen(text);
+  uint8_t textWidth = NCHAR_WIDTH(numChars, OVERLAY_FONT_SIZE);
+  drawString({pos.x + (w - textWidth) / 2, pos.y + (h - FONT_HEIGHT * OVERLAY_FONT_SIZE) / 2}, OVERLAY_FONT_SIZE, (char*)text, colour, COLOUR_BLACK);
+}
+
+/*
+  Show a short message in a box just big enough for it, which will disappear after OVERLAY_TOAST_TIMEOUT_MS
+ */
+void showToast(const char* text, uint16_t colour) {
+  uint8_t numChars = strlen(text);
+  uint8_t w = NCHAR_WIDTH(numChars, OVERLAY_FONT_SIZE) + 2 * (OVERLAY_PADDING + OVERLAY_BORDER_WIDTH);
+  uint8_t h = FONT_HEIGHT * OVERLAY_FONT_SIZE + 2 * (OVERLAY_PADDING + OVERLAY_BORDER_WIDTH);
+  showOverlay({120 - w / 2, OVERLAY_TOAST_Y}, w, h, text, colour, OVERLAY_TOAST_TIMEOUT_MS);
+}
+
+/*
+  Remove the overlay, and get the screen underneath to repaint only the rectangle that the overlay covered
+ */
+void dismissOverlay() {
+  if (!overlayVisible)
+    return;
+  overlayVisible = false;
+  repaintScreenRegion(overlayPos, overlayWidth, overlayHeight);
+}
+
+/*
+  Check whether the overlay is currently drawn
+ */
+bool isOverlayVisible() {
+  return overlayVisible;
+}
+
+/*
+  Called by the screen controller in place of the screen loop whilst the overlay is visible
+ */
+void overlayLoop() {
+  if (overlayVisible && overlayTimeoutMS != OVERLAY_NO_TIMEOUT && millis() - overlayShownTime > overlayTimeoutMS)
+    dismissOverlay();
+}
@@ -1,15 +1,21 @@
-#include <Wire.h>
-
 #include "headers/bluetooth.h"
+#include "headers/boot.h"
+#include "headers/coroutine.h"
+#include "headers/deepSleep.h"
 #include "headers/display.h"
 #include "headers/fastSPI.h"
+#include "headers/i2c.h"
 #include "headers/interrupts.h"  
 #include "headers/screenController.h"
 #include "headers/ioControl.h"
 #include "headers/p8Time.h"
 #include "headers/pinout.h"
 #include "headers/powerControl.h"
+#include "headers/powerModel.h"
+#include "headers/retained.h"
+#include "headers/scheduler.h"
 #include "headers/touch.h"
+#include "headers/twim.h"
 #include "headers/watchdog.h"
 #include "nrf52.h"
 
@@ -20,23 +26,27 @@ void setup() {
   pinMode(PUSH_BUTTON_OUT, OUTPUT);
   digitalWrite(PUSH_BUTTON_OUT, HIGH);
 #endif
-  if (digitalRead(PUSH_BUTTON_IN)) {  //If the button is held at boot, enter bootloader
+  //If the button is held at boot, enter bootloader (unless the button press is what woke the watch from System OFF)
+  if (!(NRF_POWER->RESETREAS & POWER_RESETREAS_OFF_Msk) && digitalRead(PUSH_BUTTON_IN)) {
     /* This sets a bit in the general purpose retention register which (I assume) 
     the bootloader sees and halts booting */
     NRF_POWER->GPREGRET = 0x01;
     NVIC_SystemReset();
   }
-  initIO();        //Init GPIO
-  initWatchdog();  //Start the watchdog
-  initFastSPI();   //Initialize EasyDMA SPI
-  initDisplay();   //Initialize display
-  drawChar({100, 120 - 32}, 8, GLYPH_SMILEY, COLOUR_WHITE, COLOUR_BLACK);
-  Wire.begin();
-  Wire.setClock(250000);
-  initTouch();       //Initialize touch panel
-  initInterrupts();  //Setup interrupts
-  initSleep();       //Initialize the sleep power mode
-  initScreen();      //Setup the homescreen
+  initRetained();    //Record this boot in retained RAM (keeping the record of the last boot)
+  checkFastRestore();  //Waking from System OFF, so skip what doesn't need redoing (see deepSleep.cpp)
+  initScheduler();   //Start the RTC that wakes the CPU for scheduled tasks
+  initCoroutines();  //Allow multi-step sequences (display and touch setup) to run in the background
+  initPowerModel();  //Start accounting the time each peripheral spends in each power state
+  /* 
+    Init GPIO, the watchdog, EasyDMA SPI and I2C (shared by every I2C device through the scheduler in i2c.cpp),
+    the display, the touch panel, interrupts and the sleep power mode, and set up the homescreen
+    Each stage is started as soon as the stages it needs are done, so their waits overlap (see boot.cpp)
+  */
+  runBootSequence();
+#ifdef BLE_ENABLED
+  initBluetooth();   //Softdevice and advertising, so the power model can be dumped over BLE (see bluetooth.cpp)
+#endif
   randomTests();     //Debugging stuff
 }
 
@@ -48,34 +58,39 @@ void randomTests() {
 
 void loop() {
   if (!getButtonState()) {  //If the button is pressed, we don't want to feed the watchdog (allows for rebooting if needed)
-    feedWatchdog();
+    feedWatchdog();         //Checks in for the main loop, and for subsystems that are parked (the rest check in themselves)
   }
 
-  //feedBle();
-
-  addToCumulativeBatReading();  //Battery readings are taken over a period and the mean is taken periodically to get a more accurate reading
+#ifdef BLE_ENABLED
+  feedBle();
+#endif
 
   /* 
-    Interrupts will wake the device and cause the interrupt handler to run.
-    The device then starts running thread mode code (normal code) from where it last slept
-    That means that if the interrupt didn't cause getPowerMode to be awake, then the device will
-    go back to sleep
-    If the type of interrupt is one where the device wakes up (eg button press), then
-    the THREAD MODE interrupt handler (not the NVIC interrupt handler) will set the device wakeup state (as well as enabling hardware),
-    meaning that the screenControllerLoop is run and the device is awake 
+    Everything that happens periodically (battery sampling and averaging, the screen refresh and the sleep timeout)
+    is a scheduler task, so this only runs the tasks whose deadline has passed
+    Screen tasks are only run whilst getPowerMode is awake
   */
-  if (getPowerMode() == POWER_ON) {
-    screenControllerLoop();  //This will run the main loop of the current screen
-  } else {
-    sleepWait();  //This puts the MCU into its sleep mode, only waking on an interrupt
-  }
+  runScheduledTasks();
 
   /* 
-    If any interrupts were detected, this function will dispatch any events, and
-    reset the interrupt flag. This is not the NVIC interrupt handler, but a function called
-    in the main loop. This means that the interrupt handlers can just be simple flag-sets, and we 
+    If any interrupts were detected, this function will dispatch every event in the interrupt event queue.
+    This is not the NVIC interrupt handler, but a function called
+    in the main loop. This means that the interrupt handlers can just be simple queue pushes, and we 
     can guarantee the atomic execution of actual interrupt handling (ie making sure that the interrupt handler
     doesn't read i2c whilst another part of the program was).
    */
   handleInterrupts();
+
+  runCoroutines();  //Resume any multi-step sequences (eg the touch controller reset on wake) that are waiting on something that has finished
+
+  /* 
+    Interrupts will wake the device and cause the interrupt handler to run.
+    The device then starts running thread mode code (normal code) from where it last slept
+    The RTC also wakes the device at the deadline of the next task, so the CPU only wakes when there is
+    something to do, rather than to check the time
+    If the type of interrupt is one where the device wakes up (eg button press), then
+    the THREAD MODE interrupt handler (not the NVIC interrupt handler) will set the device wakeup state (as well as enabling hardware),
+    meaning that the screen refresh task is run and the device is awake 
+  */
+  sleepWait();  //This puts the MCU into its sleep mode until the next task deadline or an interrupt
 }
@@ -1,8 +1,26 @@
 #include "headers/powerControl.h"
 
+#include "headers/screenController.h"
+
 uint8_t sleepTime = 10;
 int lastWakeTime = 0;
 bool powerMode = POWER_ON;
+uint8_t sleepTimeoutTask = NO_TASK;
+bool backlightDimmed = false;  //The sleep timeout has nearly run out, so the backlight has been dimmed as a warning
+bool touchAwake = true;        //False after a wake that left the touch controller in deep sleep (see wakeTouch())
+bool raiseWakeUnconfirmed = false;  //Woken by a wrist raise, and it hasn't been held up or used since
+uint16_t raiseWakeCount = 0;
+uint16_t falseRaiseWakeCount = 0;   //Raise wakes where the watch was lowered again straight away (see endRaiseWakeCheck())
+
+uint32_t wakeupWindowStart = 0;  //RTC tick at which the current wakeup count was started
+uint16_t wakeupsInWindow = 0;
+uint16_t wakeupsPerSecond = 0;
+
+CoTask wakeTask;
+uint32_t wakeStartTick;          //RTC tick of the input that woke the watch
+uint32_t displaySleepOutTick;    //RTC tick at which the display was taken out of sleep
+uint32_t lastWakeLatencyTicks = 0;
+uint32_t maxWakeLatencyTicks = 0;
 
 void initSleep() {
   sd_power_mode_set(NRF_POWER_MODE_LOWPWR);  //Use the softdevice wrapper to set the power mode when in CPU sleep
@@ -10,32 +28,129 @@ void initSleep() {
                                              //svc 59
                                              //bx r14
   sd_power_dcdc_mode_set(NRF_POWER_DCDC_DISABLE);
+  sleepTimeoutTask = addTask(checkWakeTime, 0, sleepTime * 1000 - SLEEP_DIM_MS);
 }
 
 /* 
   Enter sleep mode by disabling touch controller, display, backlight, led and motorOutput
  */
 void enterSleep() {
-  sleepTouchController();
+  cancelCoroutine(&wakeTask);  //In case the watch is still waking up
+  backlightDimmed = false;
+  raiseWakeUnconfirmed = false;
+  if (touchAwake)  //Otherwise it is still in deep sleep from the last sleep
+    sleepTouchController();
+  touchAwake = false;
+  setPowerState(POWER_CONSUMER_TOUCH, POWER_STATE_IDLE);
 
   setPowerMode(POWER_OFF);
   sleepDisplay();
+  waitForSPI();           //The display buffer can't be switched off whilst EasyDMA is reading it
+  powerDownScratchRAM();
   setBrightness(BACKLIGHT_OFF);
-  ledOutput(POWER_OFF);
-  motorOutput(POWER_OFF);
+  stopPatterns();  //The outputs are left off once stopped
 }
 
 /* 
   Exit sleep
+  wakeTick is the RTC tick of the input that caused the wake, used to measure the wake latency
+  withTouch = false leaves the touch controller in deep sleep until something calls wakeTouch() (for wake sources that
+  don't mean the user is about to touch the screen, like a double tap)
+  Rather than each step waiting for the last, the wake is a pipeline (see wakeSequence()), and input is handled straight away
+ */
+void exitSleep(uint32_t wakeTick, bool withTouch) {
+  wakeStartTick = wakeTick;
+  powerUpScratchRAM();  //Before anything is drawn
+  setPowerMode(POWER_ON);
+  if (withTouch)
+    wakeTouch();
+  startCoroutine(&wakeTask, wakeSequence);
+}
+
+/* 
+  Wake because the accelerometer saw a wrist raise (see accelInterruptSequence())
+  Glancing at the time doesn't need the touch controller, so it is left in deep sleep until a tap or the button (see wakeTouch())
+  Whether the raise was meant is worked out afterwards from how the watch is held (see endRaiseWakeCheck())
+ */
+void raiseWake(uint32_t wakeTick) {
+  exitSleep(wakeTick, false);
+  updateLastWakeTime();
+  raiseWakeUnconfirmed = true;
+  raiseWakeCount++;
+}
+
+/* 
+  Check whether the last raise wake is still waiting to be confirmed (see endRaiseWakeCheck())
+ */
+bool isRaiseWakeUnconfirmed() {
+  return raiseWakeUnconfirmed;
+}
+
+/* 
+  Finish checking the last raise wake, called by the accelerometer once the watch has been lowered (a false wake), or
+  has been held face up for long enough (a real one). Any input before then also confirms it (see updateLastWakeTime())
+ */
+void endRaiseWakeCheck(bool lowered) {
+  if (raiseWakeUnconfirmed && lowered)
+    falseRaiseWakeCount++;
+  raiseWakeUnconfirmed = false;
+}
+
+/* 
+  Get the number of wrist raise wakes (or only the false ones, that were lowered again straight away, if falseOnly is true)
+ */
+uint16_t getRaiseWakeCount(bool falseOnly) {
+  return falseOnly ? falseRaiseWakeCount : raiseWakeCount;
+}
+
+/* 
+  Take the touch controller out of deep sleep if a wake left it there (the reset runs on its own in the background)
  */
-void exitSleep() {
+void wakeTouch() {
+  if (touchAwake || getPowerMode() == POWER_OFF)
+    return;
+  touchAwake = true;
   resetTouchController();
+  setPowerState(POWER_CONSUMER_TOUCH, POWER_STATE_ACTIVE);
+}
 
-  setPowerMode(POWER_ON);
-  wakeDisplay();
-  setBrightness(getBrightness());
-  ledOutput(POWER_OFF);
-  motorOutput(POWER_OFF);
+/* 
+  Get the remaining part of the display's sleep out time in ms
+ */
+static uint32_t displaySleepOutRemainingMS() {
+  uint32_t elapsedMS = RTC_TICKS_TO_MS(RTC_TICK_DIFF(RTC_TICKS(), displaySleepOutTick));
+  return elapsedMS >= DISPLAY_SLEEP_OUT_MS ? 0 : DISPLAY_SLEEP_OUT_MS - elapsedMS;
+}
+
+/* 
+  Coroutine that wakes the hardware
+  The touch reset (if any, see exitSleep()) runs on its own in the background, and the display is taken out of sleep straight away
+  The display takes no commands until DISPLAY_SLEEP_OUT_MS after sleep out, and there is no RAM for a frame buffer
+  (a 240x240 frame is 115KB) to draw into in the meantime, so the current screen is drawn into display memory once the
+  wait is over. The display is left off whilst drawing, and the backlight only starts fading in once the panel has shown
+  a frame of the new pixels, so the old contents of display memory are never seen
+ */
+uint8_t wakeSequence(CoTask* co) {
+  CO_BEGIN(co);
+  displaySleepOut();
+  displaySleepOutTick = RTC_TICKS();
+  CO_DELAY_MS(co, displaySleepOutRemainingMS());
+  refreshScreenNow();
+  displayOn();
+  CO_DELAY_MS(co, DISPLAY_FRAME_MS);
+  fadeBrightness(getBrightness(), BACKLIGHT_WAKE_FADE_MS);  //Ramps up in hardware, nothing waits for it
+  lastWakeLatencyTicks = RTC_TICK_DIFF(RTC_TICKS(), wakeStartTick);
+  if (lastWakeLatencyTicks > maxWakeLatencyTicks)
+    maxWakeLatencyTicks = lastWakeLatencyTicks;
+  CO_END(co);
+}
+
+/* 
+  Get the time from the wake input to the backlight starting to turn on in microseconds
+  (for the last wake, or the worst seen if getMax is true)
+ */
+uint32_t getWakeLatencyUS(bool getMax) {
+  return RTC_TICKS_TO_US(getMax ? maxWakeLatencyTicks : lastWakeLatencyTicks);
 }
 
 /* 
@@ -43,6 +158,7 @@ void exitSleep() {
  */
 void setPowerMode(bool powerModeToSet) {
   powerMode = powerModeToSet;
+  parkWatchdogChannel(WATCHDOG_CHANNEL_RENDER, powerMode == POWER_OFF);  //The screen isn't refreshed whilst asleep
 }
 
 /* 
@@ -55,18 +171,33 @@ bool getPowerMode() {
 /* 
   Whenever the device receives a touch or button interrupt, a global variable should
   be updated with the current millis().
-  There should be a function in loop() that checks whether the current time is over
-  n milliseconds of the current wake time, if so, it should put the device to sleep
+  This also moves the deadline of the sleep timeout task, so the device goes to sleep
+  sleepTime seconds after the last input without anything having to poll the time
+  If the backlight had been dimmed for the coming sleep, it is brought back up
  */
 void updateLastWakeTime() {
   lastWakeTime = millis();
+  raiseWakeUnconfirmed = false;  //Someone is using the watch
+  scheduleTask(sleepTimeoutTask, sleepTime * 1000 - SLEEP_DIM_MS);
+  if (backlightDimmed) {
+    backlightDimmed = false;
+    fadeBrightness(getBrightness(), BACKLIGHT_UNDIM_FADE_MS);
+  }
 }
 
 /* 
-  If we have passed over the wake time, go to sleep
+  Sleep timeout task, run SLEEP_DIM_MS before sleepTime seconds have passed since the last input
+  The first time it dims the backlight (so it is obvious the watch is about to sleep, and it uses less power), and
+  then SLEEP_DIM_MS later it puts the watch to sleep
  */
 void checkWakeTime() {
-  if (millis() - lastWakeTime > sleepTime * 1000) {
+  if (getPowerMode() != POWER_ON)
+    return;
+  if (!backlightDimmed) {
+    backlightDimmed = true;
+    fadeBacklight(getBacklightDuty() / SLEEP_DIM_DIVISOR, BACKLIGHT_DIM_FADE_MS);
+    scheduleTask(sleepTimeoutTask, SLEEP_DIM_MS);
+  } else {
     enterSleep();
   }
 }
@@ -79,18 +210,46 @@ int getLastWakeTime(){
 }
 
 /* 
-  Set the time to sleep (unused in this branch)
+  Set the time to sleep (set by the power governor)
  */
 void setSleepTime(uint8_t seconds){
   sleepTime = seconds;
+  updateLastWakeTime();
 }
 
 /* 
-  Put the processor into lowest sleep state
+  Put the processor into lowest sleep state until the next task deadline (or an interrupt)
+  If a task is already due, this returns straight away
  */
 void sleepWait() {
+  if (!armNextDeadline())
+    return;
+  setPowerState(POWER_CONSUMER_CPU, POWER_STATE_IDLE);
   //Calling wait, send, wait fixes a bug where sometimes the CPU won't sleep the first time
   __WFE();
   __SEV();
   __WFE();
+  setPowerState(POWER_CONSUMER_CPU, POWER_STATE_ACTIVE);
+  countWakeup();
+}
+
+/* 
+  Count the times the CPU wakes from sleepWait(), and update the wakeups per second once at least a second has passed
+  This is done on wakeup rather than from a timer, so measuring the wakeups doesn't add any
+ */
+void countWakeup() {
+  wakeupsInWindow++;
+  uint32_t elapsed = RTC_TICK_DIFF(RTC_TICKS(), wakeupWindowStart);
+  if (elapsed >= 32768) {
+    wakeupsPerSecond = ((uint64_t)wakeupsInWindow << 15) / elapsed;
+    wakeupsInWindow = 0;
+    wakeupWindowStart = RTC_TICKS();
+  }
+}
+
+/* 
+  Get the number of times per second that the CPU woke from sleep (over the last second or more)
+ */
+uint16_t getWakeupsPerSecond() {
+  return wakeupsPerSecond;
 }
\ No newline at end of file
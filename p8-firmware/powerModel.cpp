@@ -0,0 +1,142 @@
+#include "headers/powerModel.h"
+
+/*
+  Energy accounting
+  Every place that changes the power state of a consumer (setBrightness(), display sleep/wake, enableSPI(), enterSleep()/exitSleep(),
+  the scratch RAM power down and sleepWait()) tells the model, which timestamps the change and adds the charge used in the previous state
+  Charge is current (from the table below) * time, so the average current of each consumer since boot is just its charge
+  divided by the time since boot. An average current in uA is the same as uAh used per hour
+  Currents are in nA, as some consumers (eg a section of RAM) use far less than 1uA
+  The table is only an estimate and can be calibrated with setPowerCurrentNA() against a real measurement
+ */
+
+//Current in nA of each consumer in each state
+uint32_t powerCurrentTableNA[NUM_POWER_CONSUMERS][MAX_POWER_STATES] = {
+    {3000, 6000000},                                                           //CPU: WFE (System ON, RTC running), running from flash at 64MHz
+    {0, 2500000, 5000000, 7500000, 10000000, 12500000, 15000000, 17500000},  //Backlight: per brightness level
+    {10000, 5000000},                                                          //Display: sleep in, on
+    {0, 1000000},                                                              //SPI: disabled, enabled
+    {5000, 1500000},                                                           //Touch controller: asleep, awake
+    {0, 30, 60, 90, 120, 150, 180, 210},                                       //Scratch RAM: per powered 4KB section
+};
+
+const char* powerConsumerNames[NUM_POWER_CONSUMERS] = {"CPU", "Backlight", "Display", "SPI", "Touch", "RAM"};
+
+PowerConsumer powerConsumers[NUM_POWER_CONSUMERS];
+uint64_t powerModelElapsedTicks = 0;
+uint32_t powerModelLastTick = 0;
+
+/* 
+  Start the model, every consumer starts idle (apart from the CPU, which is running this, and the RAM, which is all on)
+ */
+void initPowerModel() {
+  uint32_t now = RTC_TICKS();
+  for (uint8_t i = 0; i < NUM_POWER_CONSUMERS; i++)
+    powerConsumers[i] = {POWER_STATE_IDLE, now, 0};
+  powerConsumers[POWER_CONSUMER_CPU].state = POWER_STATE_ACTIVE;
+  powerConsumers[POWER_CONSUMER_RAM].state = MAX_POWER_STATES - 1;  //Corrected as soon as the scratch RAM is registered
+  powerModelLastTick = now;
+  addTask(updatePowerModel, POWER_MODEL_UPDATE_MS, POWER_MODEL_UPDATE_MS, TASK_ALWAYS);
+}
+
+/* 
+  Add the charge used by a consumer since it was last integrated
+ */
+static void integrateConsumer(PowerConsumer* consumer, uint8_t index, uint32_t now) {
+  consumer->chargeNATicks += (uint64_t)powerCurrentTableNA[index][consumer->state] * RTC_TICK_DIFF(now, consumer->lastTick);
+  consumer->lastTick = now;
+}
+
+/* 
+  Record a state change of a consumer
+ */
+void setPowerState(uint8_t consumer, uint8_t state) {
+  if (consumer >= NUM_POWER_CONSUMERS || state >= MAX_POWER_STATES || powerConsumers[consumer].state == state)
+    return;
+  integrateConsumer(&powerConsumers[consumer], consumer, RTC_TICKS());
+  powerConsumers[consumer].state = state;
+}
+
+/* 
+  Change the current of a state (for calibration)
+ */
+void setPowerCurrentNA(uint8_t consumer, uint8_t state, uint32_t currentNA) {
+  if (consumer >= NUM_POWER_CONSUMERS || state >= MAX_POWER_STATES)
+    return;
+  updatePowerModel();  //So the time already spent is counted at the old current
+  powerCurrentTableNA[consumer][state] = currentNA;
+}
+
+/* 
+  Bring every consumer up to date (also a scheduler task, so no consumer goes long enough without a change for the RTC to wrap)
+ */
+void updatePowerModel() {
+  uint32_t now = RTC_TICKS();
+  for (uint8_t i = 0; i < NUM_POWER_CONSUMERS; i++)
+    integrateConsumer(&powerConsumers[i], i, now);
+  powerModelElapsedTicks += RTC_TICK_DIFF(now, powerModelLastTick);
+  powerModelLastTick = now;
+}
+
+/* 
+  Get the average current of a consumer since boot in nA
+ */
+uint32_t getAverageCurrentNA(uint8_t consumer) {
+  updatePowerModel();
+  if (consumer >= NUM_POWER_CONSUMERS || powerModelElapsedTicks == 0)
+    return 0;
+  return powerConsumers[consumer].chargeNATicks / powerModelElapsedTicks;
+}
+
+/* 
+  Get the average current of a consumer since boot in uA (= uAh per hour)
+ */
+uint32_t getAverageCurrentUA(uint8_t consumer) {
+  return getAverageCurrentNA(consumer) / 1000;
+}
+
+/* 
+  Get the average current of the whole watch since boot in uA
+ */
+uint32_t getTotalAverageCurrentUA() {
+  uint32_t totalNA = 0;
+  for (uint8_t i = 0; i < NUM_POWER_CONSUMERS; i++)
+    totalNA += getAverageCurrentNA(i);
+  return totalNA / 1000;
+}
+
+/* 
+  Estimate how long a full battery would last at the average current since boot
+ */
+uint32_t getEstimatedBatteryLifeHours() {
+  uint32_t total = getTotalAverageCurrentUA();
+  if (total == 0)
+    return 0;
+  return (uint32_t)BATTERY_CAPACITY_MAH * 1000 / total;
+}
+
+/* 
+  Get the display name of a consumer
+ */
+const char* getPowerConsumerName(uint8_t consumer) {
+  return consumer < NUM_POWER_CONSUMERS ? powerConsumerNames[consumer] : "";
+}
+
+/* 
+  Write the model as comma separated lines (consumer, state, average nA) to Serial, or any other Print (eg over BLE)
+ */
+void dumpPowerModel(Print& out) {
+  out.print("uptime_s,");
+  out.println((uint32_t)(powerModelElapsedTicks >> 15));
+  for (uint8_t i = 0; i < NUM_POWER_CONSUMERS; i++) {
+    out.print(powerConsumerNames[i]);
+    out.print(',');
+    out.print(powerConsumers[i].state);
+    out.print(',');
+    out.println(getAverageCurrentNA(i));
+  }
+  out.print("total_ua,");
+  out.println(getTotalAverageCurrentUA());
+  out.print("battery_life_h,");
+  out.println(getEstimatedBatteryLifeHours());
+}
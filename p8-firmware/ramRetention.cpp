@@ -0,0 +1,78 @@
+#include "headers/ramRetention.h"
+
+/*
+  Scratch RAM power down
+  Buffers that are only used whilst the watch is awake and are always filled before being read (the display buffer)
+  don't need to keep their contents whilst asleep, so the RAM sections they occupy are switched off (power and retention)
+  in enterSleep() and back on in exitSleep()
+  The linker script belongs to the Arduino core, so buffers can't be moved into dedicated blocks from here. Instead each
+  buffer registers its address range at runtime, and only the 4KB sections that lie completely inside a registered
+  buffer are switched off (a section shared with any other variable is always kept). lcdBuffer (15KB) covers at least 2
+  whole sections wherever the linker puts it, and usually 3
+  Nothing may touch a scratch buffer (including EasyDMA) between powerDownScratchRAM() and powerUpScratchRAM()
+ */
+
+uint16_t scratchSectionMask = 0;  //Bit n = RAM section n (RAM[n / 2].S(n % 2)) is scratch
+bool scratchRAMPowered = true;
+
+/* 
+  Register a buffer whose contents don't need to be kept whilst asleep
+ */
+void addScratchRAM(void* start, uint32_t length) {
+  uint32_t firstSection = ((uint32_t)start - RAM_START + RAM_SECTION_SIZE - 1) / RAM_SECTION_SIZE;  //Round up
+  uint32_t endSection = ((uint32_t)start - RAM_START + length) / RAM_SECTION_SIZE;                  //Round down
+  for (uint32_t i = firstSection; i < endSection && i < NUM_RAM_SECTIONS; i++)
+    scratchSectionMask |= 1 << i;
+  setPowerState(POWER_CONSUMER_RAM, getScratchRAMSections());
+}
+
+/* 
+  Switch the scratch sections off (their contents are lost)
+ */
+void powerDownScratchRAM() {
+  if (!scratchRAMPowered)
+    return;
+  for (uint8_t i = 0; i < NUM_RAM_SECTIONS; i++) {
+    if (scratchSectionMask & (1 << i)) {
+      uint8_t section = i % 2;
+      NRF_POWER->RAM[i / 2].POWERCLR = (POWER_RAM_POWERCLR_S0POWER_Msk << section) | (POWER_RAM_POWERCLR_S0RETENTION_Msk << section);
+    }
+  }
+  scratchRAMPowered = false;
+  setPowerState(POWER_CONSUMER_RAM, 0);
+}
+
+/* 
+  Switch the scratch sections back on (they have to be filled before being read)
+ */
+void powerUpScratchRAM() {
+  if (scratchRAMPowered)
+    return;
+  for (uint8_t i = 0; i < NUM_RAM_SECTIONS; i++) {
+    if (scratchSectionMask & (1 << i))
+      NRF_POWER->RAM[i / 2].POWERSET = POWER_RAM_POWERSET_S0POWER_Msk << (i % 2);
+  }
+  scratchRAMPowered = true;
+  setPowerState(POWER_CONSUMER_RAM, getScratchRAMSections());
+}
+
+/* 
+  Get the number of 4KB sections that are switched off whilst asleep (also the power model state when they are on)
+ */
+uint8_t getScratchRAMSections() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < NUM_RAM_SECTIONS; i++)
+    count += (scratchSectionMask >> i) & 1;
+  return count < MAX_POWER_STATES ? count : MAX_POWER_STATES - 1;  //The power model's states only go up to 7 sections
+}
+
+/* 
+  Keep the RAM sections holding a variable through System OFF (every section loses its contents in System OFF unless its
+  retention is on, and it is off by default)
+ */
+void retainRAMInSystemOff(void* start, uint32_t length) {
+  uint32_t firstSection = ((uint32_t)start - RAM_START) / RAM_SECTION_SIZE;
+  uint32_t lastSection = ((uint32_t)start - RAM_START + length - 1) / RAM_SECTION_SIZE;
+  for (uint32_t i = firstSection; i <= lastSection && i < NUM_RAM_SECTIONS; i++)
+    NRF_POWER->RAM[i / 2].POWERSET = POWER_RAM_POWERSET_S0RETENTION_Msk << (i % 2);
+}
@@ -0,0 +1,24 @@
+#include "headers/retained.h"
+
+/*
+  The retained data is in the .noinit section, which the startup code doesn't zero (unlike .bss), so whatever was
+  written before a reset (watchdog, crash or NVIC_SystemReset()) is still there afterwards
+  The magic number tells us whether the contents are from a previous boot or just random power on RAM
+ */
+RetainedData retained __attribute__((section(".noinit")));
+
+/* 
+  Check the retained data and start the record of this boot, must be called first thing in setup()
+ */
+void initRetained() {
+  if (retained.magic != RETAINED_MAGIC) {
+    memset(&retained, 0, sizeof(retained));
+    retained.magic = RETAINED_MAGIC;
+  }
+  retained.bootCount++;
+  retained.resetReason = NRF_POWER->RESETREAS;
+  NRF_POWER->RESETREAS = 0xFFFFFFFF;  //Clear by writing back the set bits, so the next reset reason isn't mixed with this one
+  retained.lastBoot = retained.boot;
+  retained.lastWatchdogAlive = retained.watchdogAlive;
+  memset(&retained.boot, 0, sizeof(retained.boot));
+}
@@ -0,0 +1,88 @@
+#include "headers/saadc.h"
+
+/*
+  Driver for the SAADC that samples one analog pin in the background, without the CPU (used for the battery voltage)
+  Rather than analogRead() (which starts a conversion and busy waits for it), sampling is driven through PPI:
+    RTC2 hardware tick (see startHardwareTick()) -> SAMPLE
+    END -> START
+  Each SAMPLE does 8 conversions back to back (burst oversampling) and EasyDMA writes the average into the next entry
+  of a ring of SAADC_RING_SIZE results. When the ring is full the END event restarts it from the beginning through the
+  second PPI channel, so the ring always holds the latest SAADC_RING_SIZE samples and the SAADC never needs an interrupt
+  The CPU only looks at the ring when it wants a reading (see getSAADCSamples())
+  The tick is only moved on when the CPU wakes for something else, so whilst the watch is asleep and the CPU is rarely
+  woken the ring holds the samples from the last few wakes instead
+ */
+
+volatile int16_t saadcRing[SAADC_RING_SIZE];
+
+/* 
+  Get the SAADC positive input for a pin (AIN0-3 are P0.02-P0.05, AIN4-7 are P0.28-P0.31)
+ */
+static uint32_t pinToAnalogInput(uint8_t pin) {
+  if (pin >= 2 && pin <= 5)
+    return SAADC_CH_PSELP_PSELP_AnalogInput0 + (pin - 2);
+  if (pin >= 28 && pin <= 31)
+    return SAADC_CH_PSELP_PSELP_AnalogInput4 + (pin - 28);
+  return SAADC_CH_PSELP_PSELP_NC;
+}
+
+/* 
+  Set up the SAADC on channel 0 for the pin, calibrate it and start sampling every samplePeriodMS
+  The scheduler must be initialized first, as the hardware tick comes from RTC2
+ */
+void initSAADC(uint8_t pin, uint32_t samplePeriodMS) {
+  for (uint8_t i = 0; i < SAADC_RING_SIZE; i++)
+    saadcRing[i] = SAADC_NO_SAMPLE;
+
+  NRF_SAADC->ENABLE = SAADC_ENABLE_ENABLE_Disabled << SAADC_ENABLE_ENABLE_Pos;
+  NRF_SAADC->INTENCLR = 0xFFFFFFFF;
+  NRF_SAADC->RESOLUTION = SAADC_RESOLUTION_VAL_12bit << SAADC_RESOLUTION_VAL_Pos;
+  NRF_SAADC->OVERSAMPLE = SAADC_OVERSAMPLE_OVERSAMPLE_Over8x << SAADC_OVERSAMPLE_OVERSAMPLE_Pos;
+  NRF_SAADC->CH[0].PSELP = pinToAnalogInput(pin) << SAADC_CH_PSELP_PSELP_Pos;
+  NRF_SAADC->CH[0].PSELN = SAADC_CH_PSELN_PSELN_NC << SAADC_CH_PSELN_PSELN_Pos;
+  NRF_SAADC->CH[0].CONFIG = (SAADC_CH_CONFIG_RESP_Bypass << SAADC_CH_CONFIG_RESP_Pos) |
+                            (SAADC_CH_CONFIG_RESN_Bypass << SAADC_CH_CONFIG_RESN_Pos) |
+                            (SAADC_CH_CONFIG_GAIN_Gain1_6 << SAADC_CH_CONFIG_GAIN_Pos) |
+                            (SAADC_CH_CONFIG_REFSEL_Internal << SAADC_CH_CONFIG_REFSEL_Pos) |
+                            (SAADC_CH_CONFIG_TACQ_40us << SAADC_CH_CONFIG_TACQ_Pos) |  //The battery divider has a high impedance
+                            (SAADC_CH_CONFIG_MODE_SE << SAADC_CH_CONFIG_MODE_Pos) |
+                            (SAADC_CH_CONFIG_BURST_Enabled << SAADC_CH_CONFIG_BURST_Pos);  //All 8 oversamples from one SAMPLE task
+  NRF_SAADC->RESULT.PTR = (uint32_t)saadcRing;
+  NRF_SAADC->RESULT.MAXCNT = SAADC_RING_SIZE;
+  NRF_SAADC->ENABLE = SAADC_ENABLE_ENABLE_Enabled << SAADC_ENABLE_ENABLE_Pos;
+
+  //Offset calibration (only done once, as the temperature of a watch doesn't change much)
+  uint32_t startTime = millis();
+  NRF_SAADC->EVENTS_CALIBRATEDONE = 0;
+  NRF_SAADC->TASKS_CALIBRATEOFFSET = 1;
+  while (!NRF_SAADC->EVENTS_CALIBRATEDONE && millis() - startTime < SAADC_CALIBRATE_TIMEOUT_MS)
+    ;
+  NRF_SAADC->EVENTS_CALIBRATEDONE = 0;
+
+  NRF_PPI->CH[SAADC_SAMPLE_PPI_CHANNEL].EEP = startHardwareTick(samplePeriodMS);
+  NRF_PPI->CH[SAADC_SAMPLE_PPI_CHANNEL].TEP = (uint32_t)&NRF_SAADC->TASKS_SAMPLE;
+  NRF_PPI->CH[SAADC_RESTART_PPI_CHANNEL].EEP = (uint32_t)&NRF_SAADC->EVENTS_END;
+  NRF_PPI->CH[SAADC_RESTART_PPI_CHANNEL].TEP = (uint32_t)&NRF_SAADC->TASKS_START;
+  NRF_PPI->CHENSET = (1U << SAADC_SAMPLE_PPI_CHANNEL) | (1U << SAADC_RESTART_PPI_CHANNEL);
+
+  NRF_SAADC->EVENTS_STARTED = 0;
+  NRF_SAADC->TASKS_START = 1;
+  while (!NRF_SAADC->EVENTS_STARTED)  //Sampling before the buffer has been picked up would lose the sample
+    ;
+  NRF_SAADC->EVENTS_STARTED = 0;
+  NRF_SAADC->TASKS_SAMPLE = 1;  //First sample straight away, rather than after a whole period
+}
+
+/* 
+  Copy the samples that have been taken into samples (which must hold SAADC_RING_SIZE), returning how many there are
+  The order of the samples isn't kept, which doesn't matter for averaging or taking the median
+ */
+uint8_t getSAADCSamples(int16_t* samples) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < SAADC_RING_SIZE; i++) {
+    int16_t sample = saadcRing[i];
+    if (sample != SAADC_NO_SAMPLE)
+      samples[count++] = sample < 0 ? 0 : sample;  //Noise around 0V can give a slightly negative result
+  }
+  return count;
+}
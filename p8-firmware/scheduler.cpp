@@ -0,0 +1,210 @@
+#include "headers/scheduler.h"
+
+#include "headers/powerControl.h"
+
+/*
+  Tickless scheduler for everything in the main loop that used to poll millis() (the battery average, the screen refresh
+  and the sleep timeout)
+  Each task has a deadline and an optional period. Rather than waking up regularly to check the time, the soonest
+  deadline is programmed into an RTC2 compare register and the CPU sleeps until exactly then (or until an input interrupt)
+  RTC2 runs from the 32kHz clock like RTC1 (which millis() and the softdevice use), so it keeps counting whilst asleep
+  and costs no more power. It counts at the full 32768Hz, so deadlines are in the same units as RTC_TICKS()
+  The counter is 24 bits (wrapping every 512 seconds), so deadlines are compared as signed differences
+  and must be less than 256 seconds away
+ */
+
+SchedulerTask schedulerTasks[MAX_SCHEDULER_TASKS];
+uint8_t numSchedulerTasks = 0;
+uint32_t hardwareTickPeriod = 0;
+
+/* 
+  Start RTC2 with the compare interrupt, which is only used to wake the CPU at a deadline
+ */
+void initScheduler() {
+  NRF_RTC2->TASKS_STOP = 1;
+  NRF_RTC2->PRESCALER = 0;  //32768Hz
+  NRF_RTC2->EVTENCLR = 0xFFFFFFFF;
+  NRF_RTC2->INTENCLR = 0xFFFFFFFF;
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+
+  NVIC_DisableIRQ(RTC2_IRQn);
+  NVIC_ClearPendingIRQ(RTC2_IRQn);
+  NVIC_SetPriority(RTC2_IRQn, SCHEDULER_IRQ_PRIORITY);
+  NVIC_EnableIRQ(RTC2_IRQn);
+
+  NRF_RTC2->TASKS_CLEAR = 1;
+  NRF_RTC2->TASKS_START = 1;
+}
+
+/* 
+  Get the ticks until a deadline (negative if it has passed)
+ */
+static int32_t ticksUntil(uint32_t deadline, uint32_t now) {
+  return ((int32_t)(RTC_TICK_DIFF(deadline, now) << 8)) >> 8;  //Sign extend the 24 bit difference
+}
+
+/* 
+  Check whether a task should be considered in the current power mode
+ */
+static bool isTaskRunnable(SchedulerTask* task) {
+  return task->scheduled && (task->whenAsleep || getPowerMode() == POWER_ON);
+}
+
+/* 
+  Register a task, returning its ID (or NO_TASK if the table is full)
+  If periodMS is 0 the task runs once, delayMS after being added (and again whenever scheduleTask() is called)
+ */
+uint8_t addTask(TaskFunction function, uint32_t periodMS, uint32_t delayMS, bool whenAsleep) {
+  if (numSchedulerTasks >= MAX_SCHEDULER_TASKS)
+    return NO_TASK;
+  uint8_t task = numSchedulerTasks++;
+  schedulerTasks[task] = {function, 0, MS_TO_RTC_TICKS(periodMS), false, whenAsleep};
+  scheduleTask(task, delayMS);
+  return task;
+}
+
+/* 
+  Set the deadline of a task to delayMS from now (0 means run on the next pass of the main loop)
+ */
+void scheduleTask(uint8_t task, uint32_t delayMS) {
+  if (task >= numSchedulerTasks)
+    return;
+  schedulerTasks[task].deadline = (SCHEDULER_TICKS() + MS_TO_RTC_TICKS(delayMS)) & 0xFFFFFF;
+  schedulerTasks[task].scheduled = true;
+}
+
+/* 
+  Set the deadline of a task to an exact RTC2 tick (see SCHEDULER_TICKS())
+ */
+void scheduleTaskAt(uint8_t task, uint32_t tick) {
+  if (task >= numSchedulerTasks)
+    return;
+  schedulerTasks[task].deadline = tick & 0xFFFFFF;
+  schedulerTasks[task].scheduled = true;
+}
+
+/* 
+  Change the period of a task (takes effect after its next run)
+ */
+void setTaskPeriod(uint8_t task, uint32_t periodMS) {
+  if (task >= numSchedulerTasks)
+    return;
+  schedulerTasks[task].period = MS_TO_RTC_TICKS(periodMS);
+}
+
+/* 
+  Stop a task from running until it is scheduled again
+ */
+void cancelTask(uint8_t task) {
+  if (task >= numSchedulerTasks)
+    return;
+  schedulerTasks[task].scheduled = false;
+}
+
+/* 
+  Run every task whose deadline has passed, called from the main loop
+  A periodic task is moved on by its period (or to a period from now if it has fallen more than a period behind)
+  Periodic tasks that are held whilst asleep are kept due, so they run as soon as the watch wakes
+  (rather than their deadline drifting so far into the past that it looks like the future)
+ */
+void runScheduledTasks() {
+  for (uint8_t i = 0; i < numSchedulerTasks; i++) {
+    SchedulerTask* task = &schedulerTasks[i];
+    uint32_t now = SCHEDULER_TICKS();
+    if (!isTaskRunnable(task)) {
+      if (task->scheduled && task->period != 0)
+        task->deadline = now;
+      continue;
+    }
+    if (ticksUntil(task->deadline, now) > 0)
+      continue;
+    if (task->period != 0) {
+      task->deadline = (task->deadline + task->period) & 0xFFFFFF;
+      if (ticksUntil(task->deadline, now) <= 0)
+        task->deadline = (now + task->period) & 0xFFFFFF;
+    } else {
+      task->scheduled = false;
+    }
+    task->function();
+  }
+}
+
+/* 
+  Move the hardware tick on a period from now once it has happened (the event is only routed through PPI, so the
+  flag is left set until this clears it)
+ */
+static void rearmHardwareTick(uint32_t now) {
+  if (hardwareTickPeriod == 0 || !NRF_RTC2->EVENTS_COMPARE[HARDWARE_TICK_CC])
+    return;
+  NRF_RTC2->EVENTS_COMPARE[HARDWARE_TICK_CC] = 0;
+  NRF_RTC2->CC[HARDWARE_TICK_CC] = (now + hardwareTickPeriod) & 0xFFFFFF;
+}
+
+/* 
+  Program the soonest deadline into the RTC compare register, called by sleepWait() just before sleeping
+  The hardware tick is moved on here too, as the CPU is awake anyway
+  Returns false if a task is already due (so the CPU shouldn't sleep at all)
+  If nothing is scheduled the compare interrupt is turned off, so only an input interrupt will wake the CPU
+ */
+bool armNextDeadline() {
+  uint32_t now = SCHEDULER_TICKS();
+  rearmHardwareTick(now);
+  bool found = false;
+  int32_t soonest = 0;
+  for (uint8_t i = 0; i < numSchedulerTasks; i++) {
+    SchedulerTask* task = &schedulerTasks[i];
+    if (!isTaskRunnable(task))
+      continue;
+    int32_t remaining = ticksUntil(task->deadline, now);
+    if (!found || remaining < soonest) {
+      soonest = remaining;
+      found = true;
+    }
+  }
+  NRF_RTC2->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+  NRF_RTC2->EVENTS_COMPARE[0] = 0;
+  if (!found)
+    return true;
+  if (soonest < SCHEDULER_MIN_TICKS)
+    return false;
+  NRF_RTC2->CC[0] = (now + soonest) & 0xFFFFFF;
+  NRF_RTC2->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+  return true;
+}
+
+/* 
+  Start a periodic RTC2 event that peripherals can be triggered from through PPI (eg SAADC sampling), without any task running
+  Returns the address of the event, to be used as a PPI event end point
+  A compare register can't move itself on, and moving it from an interrupt would wake the CPU every period. Instead
+  CC[HARDWARE_TICK_CC] is only moved on by rearmHardwareTick() when the CPU is about to sleep anyway, so there is at most
+  one tick per period, and fewer whilst the CPU is woken less often than that. The period must be less than 256 seconds
+ */
+uint32_t startHardwareTick(uint32_t periodMS) {
+  hardwareTickPeriod = MS_TO_RTC_TICKS(periodMS);
+  NRF_RTC2->EVENTS_COMPARE[HARDWARE_TICK_CC] = 0;
+  NRF_RTC2->CC[HARDWARE_TICK_CC] = (SCHEDULER_TICKS() + hardwareTickPeriod) & 0xFFFFFF;
+  NRF_RTC2->EVTENSET = RTC_EVTENSET_COMPARE1_Msk;
+  return (uint32_t)&NRF_RTC2->EVENTS_COMPARE[HARDWARE_TICK_CC];
+}
+
+/* 
+  Change the hardware tick period, from the next tick
+ */
+void setHardwareTickPeriod(uint32_t periodMS) {
+  hardwareTickPeriod = MS_TO_RTC_TICKS(periodMS);
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void RTC2_IRQHandler() {
+  //Waking the CPU is all that is needed, the due tasks are run by the main loop
+  if (NRF_RTC2->EVENTS_COMPARE[0]) {
+    NRF_RTC2->EVENTS_COMPARE[0] = 0;
+    NRF_RTC2->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+  }
+  (void)NRF_RTC2->EVENTS_COMPARE[0];
+}
+#ifdef __cplusplus
+}
+#endif
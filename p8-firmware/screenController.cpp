@@ -1,10 +1,17 @@
 #include "headers/screenController.h"
 
 #define NUM_SCREENS 6
+#define LOW_BATTERY_PERCENT 10  //Show a warning when the battery drops below this
 
-uint8_t screenUpdateMS = 20;  //Screen update time, defaults to 20ms (50hz)
+uint16_t screenUpdateMS = 20;    //Screen update time, defaults to 20ms (50hz)
+uint16_t minScreenUpdateMS = 0;  //Limit set by the power governor
 
-long lastScreenUpdate = 0;
+uint8_t screenRefreshTask = NO_TASK;
+bool lowBatteryWarningShown = false;
+bool ignoreTouchUntilUp = false;  //Set when a streamed touch was used to dismiss an overlay
+uint8_t pressedRegion = NO_HIT_REGION;  //Region drawn as pressed after a tap, until releasePressedRegion()
+uint8_t pressedRegionGeneration;
+uint32_t pressedRegionTick;
 /*
   Similar to ATCWatch, an instance of every screen will be instantiated at bootup
   There will be a pointer to the current screen which will have the methods called on it
@@ -27,9 +34,113 @@ WatchScreenBase* currentScreen = homeScreens[currentHomeScreenIndex];
   It will setup the screen and draw the indicator and update the screen refresh time
 */
 void initScreen() {
+  clearHitRegions();                                        //Remove the buttons of the last screen
   currentScreen->screenSetup();                             //Call screenSetup() on the current screen
   drawAppIndicator();                                       //Draw the app bar
-  screenUpdateMS = currentScreen->getScreenUpdateTimeMS();  //Set the current screen update time
+  addAppDrawerHitRegions();                                 //Add the app bar buttons on top of the screen's own
+  if (screenRefreshTask == NO_TASK)
+    screenRefreshTask = addTask(screenControllerLoop, screenUpdateMS, 0);
+  updateScreenUpdateTime();                                 //Set the current screen update time
+  scheduleTask(screenRefreshTask, 0);                       //Run the new screen's loop straight away
+  stopKineticScroll();                                      //A fling doesn't carry over to another screen
+  setTouchMode(currentScreen->doesImplementDrag() ? TOUCH_MODE_STREAM : TOUCH_MODE_GESTURE);
+}
+
+/* 
+  Get the index of the current home screen
+ */
+uint8_t getHomeScreenIndex() {
+  return currentHomeScreenIndex;
+}
+
+/* 
+  Change the current home screen without setting it up (for restoring the screen before initScreen() is called at boot)
+ */
+void setHomeScreenIndex(uint8_t index) {
+  if (index >= NUM_SCREENS)
+    return;
+  currentHomeScreenIndex = index;
+  currentScreen = homeScreens[currentHomeScreenIndex];
+}
+
+/* 
+  Set the refresh task's period from the current screen's update time, slowed down to the governor's limit
+ */
+void updateScreenUpdateTime() {
+  screenUpdateMS = currentScreen->getScreenUpdateTimeMS();
+  if (screenUpdateMS < minScreenUpdateMS)
+    screenUpdateMS = minScreenUpdateMS;
+  setTaskPeriod(screenRefreshTask, screenUpdateMS);
+}
+
+/* 
+  Set the shortest refresh period screens are allowed to ask for (used by the power governor, 0 means no limit)
+ */
+void setMinScreenUpdateMS(uint16_t updateMS) {
+  minScreenUpdateMS = updateMS;
+  updateScreenUpdateTime();
+}
+
+/* 
+  Hit region handlers for the app drawer, these just wrap prevScreen() and nextScreen()
+ */
+static void appDrawerPrevHandler(uint8_t regionID) {
+  prevScreen();
+}
+
+static void appDrawerNextHandler(uint8_t regionID) {
+  nextScreen();
+}
+
+/* 
+  The left and right ends of the app drawer act as prev and next buttons
+ */
+void addAppDrawerHitRegions() {
+  addHitRegion({0, 212}, 100, 28, 0, appDrawerPrevHandler);
+  addHitRegion({161, 212}, 79, 28, 0, appDrawerNextHandler);
+}
+
+/* 
+  Any input whilst an overlay is shown just dismisses the overlay
+  Returns true if the input was used to dismiss an overlay
+ */
+static bool dismissOverlayOnInput() {
+  if (isOverlayVisible()) {
+    dismissOverlay();
+    return true;
+  }
+  return false;
+}
+
+/* 
+  Make screen rows the same as display memory lines again (called before an overlay is drawn over a scrolled screen)
+  The screen is asked to redraw itself unscrolled, keeping its position, or set up again if it can't
+ */
+void unscrollScreen() {
+  if (getScrollStart() == 0)
+    return;
+  stopKineticScroll();  //A fling would scroll under the overlay
+  currentScreen->screenResetScroll();
+  if (getScrollStart() == 0)
+    return;
+  resetScroll();
+  initScreen();
+}
+
+/* 
+  Repaint a rectangle of the current screen (used when an overlay is removed)
+  The rectangle is cleared and the screen redraws its static content inside it. Dynamic content is redrawn
+  by the screen loop, which is forced to run straight away. If the screen can't repaint part of itself, it is set up again
+ */
+void repaintScreenRegion(coord pos, uint8_t w, uint8_t h) {
+  drawFilledRect(pos, w, h, COLOUR_BLACK);
+  if (!currentScreen->screenRepaintRegion(pos, w, h)) {
+    initScreen();
+    return;
+  }
+  if (pos.y + h > 213)  //If the rectangle covered the app drawer, that needs redrawing too
+    drawAppIndicator();
+  scheduleTask(screenRefreshTask, 0);
 }
 
 /* 
@@ -37,6 +148,8 @@ void initScreen() {
   else call that handler 
 */
 void handleLeftSwipe() {
+  if (dismissOverlayOnInput())
+    return;
   if (currentScreen->doesImplementSwipeRight() == false) {
     nextScreen();
   } else {
@@ -49,6 +162,8 @@ void handleLeftSwipe() {
   else call that handler
  */
 void handleRightSwipe() {
+  if (dismissOverlayOnInput())
+    return;
   if (currentScreen->doesImplementSwipeLeft() == false) {
     prevScreen();
   } else {
@@ -84,6 +199,8 @@ void nextScreen() {
   Since the main UI doesn't need a swipe up or down event (yet), just call the handler of the current screen
 */
 void handleUpSwipe() {
+  if (dismissOverlayOnInput())
+    return;
   currentScreen->swipeUp();
 }
 
@@ -91,34 +208,155 @@ void handleUpSwipe() {
   Ditto as above 
 */
 void handleDownSwipe() {
+  if (dismissOverlayOnInput())
+    return;
   currentScreen->swipeDown();
 }
 
 /* 
-  A button press will ALWAYS return to the time screen NO MATTER WHAT (no application 
-  can have access to a button press event)
+  Button presses are classified by the button engine (see button.cpp). No application can have access to a button event
+  A short press will ALWAYS return to the time screen NO MATTER WHAT
+  A double press puts the watch to sleep
+  A long press warns that holding the button reboots the watch (the watchdog isn't fed whilst it is held)
  */
-void handleButtonPress() {
-  if (currentHomeScreenIndex != 0) {
-    currentHomeScreenIndex = 0;
-    currentScreen = homeScreens[currentHomeScreenIndex];
-    initScreen();
+void handleButtonAction(uint8_t action) {
+  switch (action) {
+    case BUTTON_SHORT_PRESS:
+      dismissOverlayOnInput();
+      if (currentHomeScreenIndex != 0) {
+        currentScreen->screenDestroy();  //Call 'destructor' for current screen
+        currentHomeScreenIndex = 0;
+        currentScreen = homeScreens[currentHomeScreenIndex];
+        initScreen();
+      }
+      break;
+    case BUTTON_DOUBLE_PRESS:
+      enterSleep();
+      break;
+    case BUTTON_LONG_PRESS:
+      showToast("Hold to reboot", COLOUR_RED);
+      break;
   }
 }
 
 /* 
   Function called when a tap event is received by the interrupt handler 
   The parameters are the x and y coords of the tap
+  If the tap is in a hit region, the motor ticks and its handler runs (or the screen's screenRegionTap() if it has no
+  handler). The region is drawn as pressed after the handler (which may redraw the button), and is only drawn normally
+  again by a refresh at least HIT_REGION_PRESSED_MS later, so the feedback is actually seen
+  Otherwise a tap on the main application is passed to screenTap()
 */
 void handleTap(uint8_t x, uint8_t y) {
-  if (y < 212) {  //If the tap is on the main application
-    currentScreen->screenTap(x, y);
-  } else {  //Else we are pressing in the app drawer buttons, so go to the prev or next screen
-    if (x < 100) {
-      prevScreen();
-    } else if (x > 160) {
-      nextScreen();
-    }
+  if (dismissOverlayOnInput())
+    return;
+  uint8_t index = findHitRegion(x, y);
+  if (index == NO_HIT_REGION) {
+    if (y < 212)  //Taps in the app drawer that aren't on a button are ignored
+      currentScreen->screenTap(x, y);
+    return;
+  }
+  HitRegion* region = getHitRegion(index);
+  uint8_t generation = getHitRegionGeneration();
+  playPattern(PATTERN_TAP);
+  releasePressedRegion(true);
+  if (region->handler != NULL)
+    region->handler(region->regionID);
+  else
+    currentScreen->screenRegionTap(region->regionID);
+  //If the handler changed screen, the region no longer exists so it mustn't be drawn
+  if (generation != getHitRegionGeneration())
+    return;
+  drawHitRegionOutline(index, true);
+  pressedRegion = index;
+  pressedRegionGeneration = generation;
+  pressedRegionTick = RTC_TICKS();
+}
+
+/* 
+  Draw the region that was drawn as pressed by handleTap() normally again, once it has been shown for
+  HIT_REGION_PRESSED_MS (or straight away if now is true). Nothing is drawn if the screen has changed since
+ */
+void releasePressedRegion(bool now) {
+  if (pressedRegion == NO_HIT_REGION)
+    return;
+  if (!now && RTC_TICKS_TO_MS(RTC_TICK_DIFF(RTC_TICKS(), pressedRegionTick)) < HIT_REGION_PRESSED_MS)
+    return;
+  if (pressedRegionGeneration == getHitRegionGeneration())
+    drawHitRegionOutline(pressedRegion, false);
+  pressedRegion = NO_HIT_REGION;
+}
+
+/* 
+  Dispatch a gesture recognised by the touch controller
+ */
+void handleGesture(TouchDataStruct* touchData) {
+  switch (touchData->gesture) {
+    case SINGLE_TAP:
+      handleTap(touchData->x, touchData->y);
+      break;
+    case LONG_PRESS:
+      handleLongTap(touchData->x, touchData->y);
+      break;
+    case SWIPE_DOWN:
+      handleDownSwipe();
+      break;
+    case SWIPE_UP:
+      handleUpSwipe();
+      break;
+    case SWIPE_LEFT:
+      handleLeftSwipe();
+      break;
+    case SWIPE_RIGHT:
+      handleRightSwipe();
+      break;
+  }
+}
+
+/* 
+  Handle a streamed touch sample (when the current screen implements drag)
+  Movement whilst the finger is down is sent to the screen as a drag. When the finger is lifted, the drag tracker
+  decides whether the touch was a tap, a horizontal swipe (to change screen) or a fling
+  tick is the RTC tick at which the touch interrupt fired
+ */
+void handleTouchSample(TouchDataStruct* touchData, uint32_t tick) {
+  int16_t dx, dy;
+  switch (touchData->event) {
+    case TOUCH_EVENT_DOWN:
+      ignoreTouchUntilUp = dismissOverlayOnInput();
+      dragTouchDown(touchData->x, touchData->y, tick);
+      break;
+    case TOUCH_EVENT_CONTACT:
+      dy = dragTouchMove(touchData->x, touchData->y, tick, &dx);
+      if (!ignoreTouchUntilUp && (dx != 0 || dy != 0))
+        currentScreen->screenDrag(dx, dy);
+      break;
+    case TOUCH_EVENT_UP:
+      if (ignoreTouchUntilUp) {
+        ignoreTouchUntilUp = false;
+        dragTouchUp(touchData->x, touchData->y, tick);
+        stopKineticScroll();
+        break;
+      }
+      //A long press, or a gesture from before the controller was put into stream mode
+      if (touchData->gesture == LONG_PRESS || (!isDragging() && touchData->gesture != NO_GESTURE && touchData->gesture != SINGLE_TAP)) {
+        dragTouchUp(touchData->x, touchData->y, tick);
+        stopKineticScroll();
+        handleGesture(touchData);
+        break;
+      }
+      switch (dragTouchUp(touchData->x, touchData->y, tick)) {
+        case DRAG_RELEASE_TAP:
+          handleTap(touchData->x, touchData->y);
+          break;
+        case DRAG_RELEASE_SWIPE_LEFT:
+          handleLeftSwipe();
+          break;
+        case DRAG_RELEASE_SWIPE_RIGHT:
+          handleRightSwipe();
+          break;
+      }
+      break;
   }
 }
 
@@ -126,6 +364,8 @@ void handleTap(uint8_t x, uint8_t y) {
   Sleep when we receive a long tap 
 */
 void handleLongTap(uint8_t x, uint8_t y) {
+  if (dismissOverlayOnInput())
+    return;
   if (currentScreen->doesImplementLongTap() == true) {  //Make sure the current screen doesn't implement the long tap
     currentScreen->screenLongTap(x, y);
   } else {
@@ -134,15 +374,46 @@ void handleLongTap(uint8_t x, uint8_t y) {
 }
 
 /* 
-  This method is called AFAP by the main loop() in p8-firmware.ino
+  This method is the screen refresh task, run by the scheduler every screenUpdateMS whilst the watch is awake
+  (the refresh time is variable depending on the current screen)
   The loop method of a screen should be as efficient as possible
     For example if any graphics are used, they should be drawn in setup rather than being redrawn every loop
  */
 void screenControllerLoop() {
-  if (millis() - lastScreenUpdate > screenUpdateMS) {
-    //The refresh time is variable depending on the current screen
+  //Whilst an overlay is visible the screen isn't updated, since it would draw over the overlay
+  if (isOverlayVisible()) {
+    overlayLoop();
+  } else {
+    if (isKineticScrolling()) {  //Keep a fling moving
+      int16_t dy = kineticScrollStep(RTC_TICKS());
+      if (dy != 0)
+        currentScreen->screenDrag(0, dy);
+    }
     currentScreen->screenLoop();
-    lastScreenUpdate = millis();
+    releasePressedRegion(false);
+  }
+  checkLowBattery();
+  watchdogCheckIn(WATCHDOG_CHANNEL_RENDER);
+}
+
+/* 
+  Run the screen refresh straight away rather than waiting for the refresh task
+  (used when waking, to draw the screen into display memory before the display is turned on)
+ */
+void refreshScreenNow() {
+  screenControllerLoop();
+  scheduleTask(screenRefreshTask, screenUpdateMS);
+}
+
+/* 
+  Show a warning toast once when the battery gets low, and reset the warning when charging
+ */
+void checkLowBattery() {
+  if (getChargeState()) {
+    lowBatteryWarningShown = false;
+  } else if (!lowBatteryWarningShown && getBatteryPercent() < LOW_BATTERY_PERCENT) {
+    lowBatteryWarningShown = true;
+    showToast("Low battery", COLOUR_RED);
   }
 }
 
@@ -1,9 +1,11 @@
 #include "headers/touch.h"
+
+#include "headers/interrupts.h"
 /*
   The touch panel is i2c address 0x15
   The controller will go to sleep when no event is detected
   It appears disconnected, so for communication to work, the controller must be woken with a tap
-  I2C on the nRF52832 also uses EasyDMA, however <Wire.h> handles everything to do with this struct: (here for reference)
+  I2C on the nRF52832 also uses EasyDMA, which is driven by twim.cpp using this struct: (here for reference)
   typedef struct {                                    TWIM Structure
     __O  uint32_t  TASKS_STARTRX;                     Start TWI receive sequence
     __O  uint32_t  TASKS_STARTTX;                     Start TWI transmit sequence
@@ -33,78 +35,140 @@
   Unlike the PineTime, the P8 watch uses the CST716S touch controller, rather than the CST816S
   However implementation wise, getting the data is equivalent
   As per the reference driver, waking the device can only be done by toggling the reset pin low for 20ms
+
+  Touch data is read asynchronously: the GPIOTE interrupt handler queues the I2C read (at the highest bus priority, see
+  i2c.cpp) as soon as the touch interrupt pin falls, and the TWIM interrupt handler pushes the finished sample into the interrupt event queue, so the data is
+  ready before the main loop even wakes up (and isn't delayed by whatever the main loop was drawing)
 */
 
-TouchDataStruct touchData = {-1, -1, -1};
+TouchDataStruct touchData = {-1, -1, -1, -1, 0};
+uint8_t touchMode = TOUCH_MODE_GESTURE;         //The mode the current screen wants
+uint8_t appliedTouchMode = TOUCH_MODE_UNKNOWN;  //The mode the controller is actually in
+
+uint8_t touchReadBuf[TOUCH_READ_LENGTH];  //EasyDMA destination for the touch data
+volatile bool touchReadInProgress = false;
+volatile bool touchReadRequested = false;  //Another touch interrupt came in whilst reading
+volatile uint32_t touchEdgeTick;            //RTC tick of the interrupt edge for the current read
+volatile uint32_t lastTouchLatencyTicks = 0;
+volatile uint32_t maxTouchLatencyTicks = 0;
+
+CoTask touchSequenceTask;  //Reset, setup or sleep sequence (a new sequence replaces one that is still running)
+bool touchResetBootup = false;
 
 /* 
   Initialize the touch panel (basically just reset and put into running (not sleeping) state)
+  This is done by a coroutine, which is returned so the caller can wait for it
 */
-void initTouch() {
+CoTask* initTouch() {
   pinMode(TP_RESET, OUTPUT);  //Reset pin
   pinMode(TP_INT, INPUT);     //Interrupt pin
-  resetTouchController(true);
-  Wire.beginTransmission(0x15);
-  Wire.write(0xED);
-  Wire.write(0xC8);
-  Wire.endTransmission();
+  return resetTouchController(true);
 }
 
 /* 
   Reset the touch controller
   Setting bootup to true will add an additional 50 msec high write to the reset pin (used to put pin into known state after boot)
   Calling just resetTouchController() will not add the bootup delay
+  At bootup the controller is also set up once it is out of reset
+  The reset runs in the background, the returned coroutine is finished when the controller is ready
  */
-void resetTouchController(bool bootup) {
-  //Reset touch controller:
-  if (bootup) {
+CoTask* resetTouchController(bool bootup) {
+  touchResetBootup = bootup;
+  startCoroutine(&touchSequenceTask, touchResetSequence);
+  return &touchSequenceTask;
+}
+
+/* 
+  Coroutine that resets the touch controller (and sets it up at bootup)
+ */
+uint8_t touchResetSequence(CoTask* co) {
+  static const uint8_t setupData = 0xC8;
+  CO_BEGIN(co);
+  if (touchResetBootup) {
     digitalWrite(TP_RESET, HIGH);
-    delay(50);
+    CO_DELAY_MS(co, 50);
   }
   digitalWrite(TP_RESET, LOW);
-  delay(5);
+  CO_DELAY_MS(co, 5);
   digitalWrite(TP_RESET, HIGH);
-  delay(50);
+  CO_DELAY_MS(co, 50);
+  appliedTouchMode = TOUCH_MODE_UNKNOWN;  //The reset puts the controller back into its default mode
+  if (touchResetBootup)
+    CO_AWAIT_I2C_WRITE(co, TOUCH_ADDRESS, 0xED, &setupData, 1);
+  CO_END(co);
 }
 
 /* 
-  Read touch data from the controller and store it in the global touchDataStruct
+  Start reading the touch data (called from the GPIOTE interrupt handler on the falling edge of the touch interrupt)
+  edgeTick is the RTC tick of the edge, which is used as the sample's timestamp and to measure the read latency
  */
-void updateTouchStruct() {
-
-  uint8_t readBufSize = 6;
-  uint8_t readBuf[readBufSize];  //Read buffer where the raw bytes are stored
-  Wire.beginTransmission(0x15);
-  Wire.write(0x1);  //Try to ping the touch controller
-  if (Wire.endTransmission()) {
-    /* 
-      Errors upon calling endTransmission()
-      0 : Success
-      1 : Data too long
-      2 : NACK on transmit of address
-      3 : NACK on transmit of data
-      4 : Other error 
-    */
-    touchData.gesture = -1;
-    touchData.x = 69;
-    touchData.y = 69;
-    return;  //If we get an unsuccessful probe, the device isn't awake, so just return
+void startTouchRead(uint32_t edgeTick) {
+  if (touchReadInProgress) {  //Read again as soon as the current read is done, so the latest position isn't missed
+    touchReadRequested = true;
+    return;
   }
-  Wire.requestFrom(0x15, readBufSize);
-  for (uint8_t i = 0; i < readBufSize; i++) {
-    readBuf[i] = Wire.read();
+  touchReadInProgress = true;
+  touchEdgeTick = edgeTick;
+  if (!i2cReadRegisters(TOUCH_ADDRESS, TOUCH_REG_DATA, touchReadBuf, TOUCH_READ_LENGTH, I2C_PRIORITY_TOUCH, touchReadComplete))
+    touchReadInProgress = false;
+}
+
+/* 
+  Called from the TWIM interrupt handler when the touch data has been read
+  The sample is stored and pushed into the interrupt event queue for the main loop
+ */
+void touchReadComplete(bool success, void* context) {
+  TouchDataStruct sample;
+  if (success) {
+    parseTouchData(touchReadBuf, &sample);
+  } else {
+    //If the read failed the device isn't awake
+    sample.gesture = -1;
+    sample.event = -1;
+    sample.fingers = 0;
+    sample.x = 69;
+    sample.y = 69;
+  }
+  lastTouchLatencyTicks = RTC_TICK_DIFF(RTC_TICKS(), touchEdgeTick);
+  if (lastTouchLatencyTicks > maxTouchLatencyTicks)
+    maxTouchLatencyTicks = lastTouchLatencyTicks;
+  touchData = sample;
+  pushInterruptEvent(EVENT_SOURCE_TOUCH, EDGE_FALLING, touchEdgeTick, &sample);
+
+  touchReadInProgress = false;
+  if (touchReadRequested) {
+    touchReadRequested = false;
+    startTouchRead(RTC_TICKS());
   }
+}
+
+/* 
+  Convert the raw bytes from the controller into a TouchDataStruct
+ */
+void parseTouchData(uint8_t* readBuf, TouchDataStruct* sample) {
   /* 
     Byte 0 = gesture
+    Byte 1 = number of fingers
+    Byte 2 = event (top 2 bits) and x MSBits
     Byte 3 = x LSByte
     Byte 5  = y LSByte
   */
-  touchData.gesture = readBuf[0];
+  sample->gesture = readBuf[0];
+  sample->fingers = readBuf[1];
+  sample->event = readBuf[2] >> 6;
   /* 
     Because the display is 240*240, the highest 4 bits of the positions are not used, meaning we can just use the lower byte of the position to get all the information we need
    */
-  touchData.x = (readBuf[3]);  // << 8 | (uint16_t)readBuf[4]; (Not needed)
-  touchData.y = (readBuf[5]);  // << 8 | (uint16_t)readBuf[6]; (Not needed)
+  sample->x = (readBuf[3]);  // << 8 | (uint16_t)readBuf[4]; (Not needed)
+  sample->y = (readBuf[5]);  // << 8 | (uint16_t)readBuf[6]; (Not needed)
+}
+
+/* 
+  Get the time between the touch interrupt edge and the data being ready in microseconds
+  (for the last touch, or the worst seen if getMax is true)
+ */
+uint32_t getTouchLatencyUS(bool getMax) {
+  return RTC_TICKS_TO_US(getMax ? maxTouchLatencyTicks : lastTouchLatencyTicks);
 }
 
 /* 
@@ -115,12 +179,57 @@ TouchDataStruct* getTouchDataStruct() {
 }
 
 /* 
-  Put the touch panel to sleep
+  Put the touch panel to sleep (in the background, this replaces a reset that is still running)
+  The returned coroutine is finished once the sleep command has been sent
+ */
+CoTask* sleepTouchController() {
+  startCoroutine(&touchSequenceTask, touchSleepSequence);
+  return &touchSequenceTask;
+}
+
+/* 
+  Check whether a reset or sleep sequence is still running (eg to wait for the sleep command to have been sent)
+ */
+bool isTouchSequenceRunning() {
+  return isCoroutineRunning(&touchSequenceTask);
+}
+
+/* 
+  Coroutine that waits for the controller to settle and then sends the sleep command
+ */
+uint8_t touchSleepSequence(CoTask* co) {
+  static const uint8_t sleepData = 0x03;
+  CO_BEGIN(co);
+  CO_DELAY_MS(co, 20);
+  CO_AWAIT_I2C_WRITE(co, TOUCH_ADDRESS, 0xA5, &sleepData, 1);
+  CO_END(co);
+}
+
+/* 
+  Set the mode that the touch controller should be in (see TOUCH_MODE definitions)
+  The controller is asleep until it is touched, so the mode can't be written straight away. Instead it is written
+  by applyTouchMode() when the next touch interrupt arrives (when we know it is awake)
+ */
+void setTouchMode(uint8_t mode) {
+  touchMode = mode;
+}
+
+/* 
+  Get the mode that the touch controller has been asked to be in
+ */
+uint8_t getTouchMode() {
+  return touchMode;
+}
+
+/* 
+  Write the requested mode to the controller if it isn't already in it (only call when the controller is awake)
  */
-void sleepTouchController() {
-  Wire.beginTransmission(0x15);
-  Wire.write(0xA5);
-  Wire.write(0x03);
-  delay(20);
-  Wire.endTransmission();
+void applyTouchMode() {
+  if (appliedTouchMode == touchMode)
+    return;
+  uint8_t irqControl = TOUCH_IRQ_EN_MOTION;
+  if (touchMode == TOUCH_MODE_STREAM)
+    irqControl |= TOUCH_IRQ_EN_TOUCH | TOUCH_IRQ_EN_CHANGE;
+  if (i2cWriteRegistersBlocking(TOUCH_ADDRESS, TOUCH_REG_IRQ_CTL, &irqControl, 1))
+    appliedTouchMode = touchMode;
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "headers/twim.h"
+
+/*
+  Register level driver for the I2C bus (touch controller, accelerometer and heart rate sensor) using TWIM0 with EasyDMA
+  This replaces <Wire.h>, which blocks until every transfer is done and can't be used from an interrupt handler
+  A transfer is a write of txLength bytes followed by a read of rxLength bytes. Both are done as one transaction
+  using shortcuts, so once started no CPU is needed until the STOPPED interrupt:
+    LASTTX -> STARTRX (repeated start straight after the register address is sent)
+    LASTRX -> STOP
+  (or LASTTX -> STOP for a write only transfer)
+  Only one transfer can be in progress at a time. Devices don't use this directly, they go through the
+  transaction scheduler in i2c.cpp, which queues and prioritises transfers and starts the next one when the bus is free
+  Note that EasyDMA can only access RAM, so buffers can't be in flash (ie const arrays)
+ */
+
+volatile bool twimBusy = false;
+volatile bool twimError = false;
+TWIMCallback currentCallback = NULL;
+
+/* 
+  Setup TWIM0 on the shared sensor bus pins
+ */
+void initTWIM() {
+  uint32_t pinConfig = (GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos) |
+                       (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos) |
+                       (GPIO_PIN_CNF_PULL_Pullup << GPIO_PIN_CNF_PULL_Pos) |
+                       (GPIO_PIN_CNF_DRIVE_S0D1 << GPIO_PIN_CNF_DRIVE_Pos) |  //Open drain, as I2C needs
+                       (GPIO_PIN_CNF_SENSE_Disabled << GPIO_PIN_CNF_SENSE_Pos);
+  NRF_GPIO->PIN_CNF[TP_SCL] = pinConfig;
+  NRF_GPIO->PIN_CNF[TP_SDA] = pinConfig;
+
+  NRF_TWIM0->ENABLE = TWIM_ENABLE_ENABLE_Disabled << TWIM_ENABLE_ENABLE_Pos;
+  NRF_TWIM0->PSEL.SCL = TP_SCL;
+  NRF_TWIM0->PSEL.SDA = TP_SDA;
+  NRF_TWIM0->FREQUENCY = TWIM_FREQUENCY_FREQUENCY_K250 << TWIM_FREQUENCY_FREQUENCY_Pos;
+  NRF_TWIM0->INTENCLR = 0xFFFFFFFF;
+  NRF_TWIM0->INTENSET = TWIM_INTENSET_STOPPED_Msk | TWIM_INTENSET_ERROR_Msk;
+
+  NVIC_DisableIRQ(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn);
+  NVIC_ClearPendingIRQ(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn);
+  NVIC_SetPriority(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn, TWIM_IRQ_PRIORITY);
+  NVIC_EnableIRQ(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn);
+
+  NRF_TWIM0->ENABLE = TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos;
+}
+
+/* 
+  Program the EasyDMA pointers and shortcuts, and start the transfer (bus must be free)
+ */
+static void startTransfer(uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength, TWIMCallback callback) {
+  twimBusy = true;
+  twimError = false;
+  currentCallback = callback;
+  NRF_TWIM0->ADDRESS = address;
+  NRF_TWIM0->TXD.PTR = (uint32_t)txBuf;
+  NRF_TWIM0->TXD.MAXCNT = txLength;
+  NRF_TWIM0->RXD.PTR = (uint32_t)rxBuf;
+  NRF_TWIM0->RXD.MAXCNT = rxLength;
+  NRF_TWIM0->EVENTS_STOPPED = 0;
+  NRF_TWIM0->EVENTS_ERROR = 0;
+  NRF_TWIM0->ERRORSRC = NRF_TWIM0->ERRORSRC;  //Clear by writing back the set bits
+  if (txLength > 0 && rxLength > 0) {
+    NRF_TWIM0->SHORTS = TWIM_SHORTS_LASTTX_STARTRX_Msk | TWIM_SHORTS_LASTRX_STOP_Msk;
+    NRF_TWIM0->TASKS_STARTTX = 1;
+  } else if (txLength > 0) {
+    NRF_TWIM0->SHORTS = TWIM_SHORTS_LASTTX_STOP_Msk;
+    NRF_TWIM0->TASKS_STARTTX = 1;
+  } else {
+    NRF_TWIM0->SHORTS = TWIM_SHORTS_LASTRX_STOP_Msk;
+    NRF_TWIM0->TASKS_STARTRX = 1;
+  }
+}
+
+/* 
+  Start a transfer. Can be called from an interrupt handler. Returns false if the bus is busy
+  The buffers must stay valid until the callback is called
+ */
+bool twimTransfer(uint8_t address, uint8_t* txBuf, uint8_t txLength, uint8_t* rxBuf, uint8_t rxLength, TWIMCallback callback) {
+  bool accepted = false;
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (!twimBusy) {
+    startTransfer(address, txBuf, txLength, rxBuf, rxLength, callback);
+    accepted = true;
+  }
+  __set_PRIMASK(primask);
+  return accepted;
+}
+
+/* 
+  Check whether a transfer is in progress
+ */
+bool twimIsBusy() {
+  return twimBusy;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQHandler() {
+  if (NRF_TWIM0->EVENTS_ERROR) {
+    //On an error (eg NACK) the transfer doesn't stop by itself
+    NRF_TWIM0->EVENTS_ERROR = 0;
+    twimError = true;
+    NRF_TWIM0->TASKS_STOP = 1;
+  }
+  if (NRF_TWIM0->EVENTS_STOPPED) {
+    NRF_TWIM0->EVENTS_STOPPED = 0;
+    NRF_TWIM0->SHORTS = 0;
+    TWIMCallback callback = currentCallback;
+    bool success = !twimError;
+    twimBusy = false;
+    if (callback != NULL)  //The callback can start the next transfer straight away
+      callback(success);
+  }
+  (void)NRF_TWIM0->EVENTS_STOPPED;
+}
+#ifdef __cplusplus
+}
+#endif
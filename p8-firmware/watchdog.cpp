@@ -1,29 +1,87 @@
 #include "headers/watchdog.h"
 
+/*
+  Each long running subsystem has its own watchdog reload register (RR channel)
+  The watchdog is only reloaded once EVERY enabled channel has been written, so if any one subsystem stops checking in
+  (eg a hung sensor task or a stuck render) the watch is reset, even if the main loop is still running
+  A subsystem that is legitimately idle (eg rendering whilst asleep, or BLE which isn't running yet) parks its channel,
+  and the main loop checks in for it
+  Which channels checked in since the last reload is kept in retained RAM, and when the watchdog times out the channels
+  that didn't check in are saved too, so the cause of a watchdog reset can be found after it
+*/
+
+uint8_t parkedWatchdogChannels = 0;
+
 /*
   Initialize the watchdog for a 5 second timeout
+  Sensors and BLE start parked, since nothing runs them yet
 */
 void initWatchdog() {
+  parkedWatchdogChannels = WATCHDOG_CHANNEL_BIT(WATCHDOG_CHANNEL_SENSORS) | WATCHDOG_CHANNEL_BIT(WATCHDOG_CHANNEL_BLE);
+  retained.watchdogAlive = 0;
   enableWatchdog(5000);
 }
 
 /*
   Enable the watchdog
+  (CRV, RREN and CONFIG can't be changed once the watchdog is running, until the next reset)
 */
 void enableWatchdog(int timeoutMillis) {
   NRF_WDT->CONFIG = (WDT_CONFIG_HALT_Pause << WDT_CONFIG_HALT_Pos) | (WDT_CONFIG_SLEEP_Pause << WDT_CONFIG_SLEEP_Pos);
   NRF_WDT->CRV = (32768 * timeoutMillis) / 1000;  //Counter reload value
-  NRF_WDT->RREN |= WDT_RREN_RR0_Msk;              //Enable reload request register 0 for resetting the watchdog
-  NRF_WDT->TASKS_START = 1;                       //Start the watchdog
+  NRF_WDT->RREN = WATCHDOG_ALL_CHANNELS;          //Enable a reload request register for every subsystem
+
+  //The timeout interrupt runs 2 32kHz cycles before the reset, which is just long enough to save which channels starved
+  NRF_WDT->INTENSET = WDT_INTENSET_TIMEOUT_Msk;
+  NVIC_ClearPendingIRQ(WDT_IRQn);
+  NVIC_SetPriority(WDT_IRQn, WATCHDOG_IRQ_PRIORITY);
+  NVIC_EnableIRQ(WDT_IRQn);
+
+  NRF_WDT->TASKS_START = 1;  //Start the watchdog
 }
 
 /*
-  Reset the watchdog timer
+  Check in for a subsystem
+  "To reload the watchdog counter, the special value 0x6E524635 needs to be written to all enabled reload registers"
+  - From the documentation
+*/
+void watchdogCheckIn(uint8_t channel) {
+  NRF_WDT->RR[channel] = WDT_RR_RR_Reload;
+  if (NRF_WDT->REQSTATUS == WATCHDOG_ALL_CHANNELS)  //That was the last channel, so the watchdog has reloaded and a new round starts
+    retained.watchdogAlive = 0;
+  else
+    retained.watchdogAlive |= WATCHDOG_CHANNEL_BIT(channel);
+}
+
+/*
+  Park or unpark a channel, a parked channel is checked in by feedWatchdog() rather than its subsystem
+*/
+void parkWatchdogChannel(uint8_t channel, bool parked) {
+  if (parked)
+    parkedWatchdogChannels |= WATCHDOG_CHANNEL_BIT(channel);
+  else
+    parkedWatchdogChannels &= ~WATCHDOG_CHANNEL_BIT(channel);
+}
+
+/*
+  Check in for the main loop (the input channel) and every parked channel
 */
 void feedWatchdog() {
-  /*
-    "To reload the watchdog counter, the special value 0x6E524635 needs to be written to all enabled reload registers"
-    - From the documentation
-  */
-  NRF_WDT->RR[0] = WDT_RR_RR_Reload;  //Loads the watchdog reload value into register 0 (the reload register that was enabled in enableWatchdog())
+  watchdogCheckIn(WATCHDOG_CHANNEL_INPUT);
+  for (uint8_t channel = 0; channel < WATCHDOG_NUM_CHANNELS; channel++) {
+    if (parkedWatchdogChannels & WATCHDOG_CHANNEL_BIT(channel))
+      watchdogCheckIn(channel);
+  }
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void WDT_IRQHandler() {
+  //The reset is about to happen, so just save the channels that didn't check in
+  retained.watchdogStarved = NRF_WDT->REQSTATUS;
+  NRF_WDT->EVENTS_TIMEOUT = 0;
+}
+#ifdef __cplusplus
 }
+#endif